@@ -0,0 +1,39 @@
+#include <cstring>
+#include <iostream>
+#include "bench.hpp"
+
+using std::endl;
+
+struct Suite
+{
+    const char* name;
+    int (*run)(int, char**);
+    const char* usage;
+};
+
+static const Suite SUITES[] = {
+    {"extract", bench_extract, "extract [--runs N] [tar]   serial ofstream extraction vs. ExtractionWriter"},
+    {"jar", bench_jar, "jar [--classes N] [--runs N]   libarchive jar vs. write_jar/update_jar"},
+    {"phases", bench_phases, "phases [--languages java,scala,kotlin] [--scales 1,100,1000,10000] [--runs N] [--json PATH] [--store DIR] [--keep]\n"
+                             "      per-phase build and run times over generated projects, as JSON"},
+    {"walk", bench_walk, "walk [--files N] [--runs N] [--tree DIR]   recursive_directory_iterator vs. walk_files"},
+};
+
+static void print_usage()
+{
+    std::cerr << "Usage: myjvm_bench <suite> [args]" << endl << "Suites:" << endl;
+    for (const Suite& suite : SUITES) std::cerr << "  " << suite.usage << endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+    for (const Suite& suite : SUITES) {
+        if (strcmp(argv[1], suite.name) == 0) return suite.run(argc - 2, argv + 2);
+    }
+    print_usage();
+    return 1;
+}
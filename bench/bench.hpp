@@ -0,0 +1,20 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Benchmark suites. Each takes the arguments after its name and returns a
+// process exit code.
+int bench_extract(int argc, char** argv);
+int bench_jar(int argc, char** argv);
+int bench_phases(int argc, char** argv);
+int bench_walk(int argc, char** argv);
+
+template <typename F>
+double time_seconds(F&& body)
+{
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
@@ -0,0 +1,108 @@
+#include <archive.h>
+#include <archive_entry.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include "../src/runtime.hpp"
+#include "bench.hpp"
+
+using std::cout;
+using std::endl;
+
+// The extraction path as it was before ExtractionWriter: one thread, one
+// ofstream per file, and executable bits patched up afterwards.
+static void legacy_extract(const std::string& tar_path, const std::string& output_dir)
+{
+    struct archive* a = archive_read_new();
+    archive_read_support_format_tar(a);
+    if (archive_read_open_filename(a, tar_path.c_str(), 10240) != ARCHIVE_OK) {
+        archive_read_free(a);
+        throw std::runtime_error("Failed to open tar file: " + tar_path);
+    }
+    archive_entry* entry;
+    while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
+        std::filesystem::path full_path = std::filesystem::path(output_dir) / archive_entry_pathname(entry);
+        auto type = archive_entry_filetype(entry);
+        if (type == AE_IFDIR) {
+            std::filesystem::create_directories(full_path);
+        }
+        else if (type == AE_IFREG) {
+            std::filesystem::create_directories(full_path.parent_path());
+            std::ofstream out(full_path, std::ios::binary);
+            const void* buff;
+            size_t size;
+            la_int64_t offset;
+            while (archive_read_data_block(a, &buff, &size, &offset) == ARCHIVE_OK) {
+                out.write(reinterpret_cast<const char*>(buff), size);
+            }
+            out.close();
+            if (archive_entry_perm(entry) & 0111) {
+                std::filesystem::permissions(full_path, std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+            }
+        }
+    }
+    archive_read_free(a);
+}
+
+// Roughly the shape of the bundled runtimes: a few thousand small files
+// spread over a few hundred directories, plus a handful of large ones.
+static void generate_tar(const std::string& tar_path)
+{
+    struct archive* a = archive_write_new();
+    archive_write_set_format_pax_restricted(a);
+    if (archive_write_open_filename(a, tar_path.c_str()) != ARCHIVE_OK) {
+        archive_write_free(a);
+        throw std::runtime_error("Failed to create " + tar_path);
+    }
+    std::string body;
+    archive_entry* entry = archive_entry_new();
+    for (int i = 0; i < 5000; i++) {
+        size_t size = i % 500 == 0 ? (8 << 20) : 512 + (i * 7919) % 16384;
+        body.assign(size, static_cast<char>('a' + i % 26));
+        std::string name = "runtime/lib/pkg" + std::to_string(i % 300) + "/file" + std::to_string(i);
+        archive_entry_clear(entry);
+        archive_entry_set_pathname(entry, name.c_str());
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_perm(entry, i % 50 == 0 ? 0755 : 0644);
+        archive_entry_set_size(entry, size);
+        archive_write_header(a, entry);
+        archive_write_data(a, body.data(), body.size());
+    }
+    archive_entry_free(entry);
+    archive_write_close(a);
+    archive_write_free(a);
+}
+
+int bench_extract(int argc, char** argv)
+{
+    int runs = 3;
+    std::string tar_path;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) runs = std::stoi(argv[++i]);
+        else tar_path = arg;
+    }
+    std::filesystem::path scratch = std::filesystem::temp_directory_path() / ("myjvm-bench-" + std::to_string(getpid()));
+    std::filesystem::create_directories(scratch);
+    if (tar_path.empty()) {
+        tar_path = (scratch / "synthetic.tar").string();
+        generate_tar(tar_path);
+    }
+    std::filesystem::path output = scratch / "out";
+    double legacy_total = 0;
+    double writer_total = 0;
+    for (int run = 0; run < runs; run++) {
+        std::filesystem::remove_all(output);
+        legacy_total += time_seconds([&] { legacy_extract(tar_path, output.string()); });
+        std::filesystem::remove_all(output);
+        writer_total += time_seconds([&] { extract_tar(tar_path, output.string()); });
+    }
+    std::filesystem::remove_all(scratch);
+    cout << "extract " << tar_path << " (" << runs << " runs)" << endl;
+    cout << "  legacy: " << legacy_total / runs << " s" << endl;
+    cout << "  writer: " << writer_total / runs << " s" << endl;
+    return 0;
+}
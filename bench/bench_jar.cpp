@@ -0,0 +1,88 @@
+#include <archive.h>
+#include <archive_entry.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include "../src/jar.hpp"
+#include "bench.hpp"
+
+using std::cout;
+using std::endl;
+
+// create_jar_from_classes as it was before the JAR writer: libarchive zip,
+// every class read through istreambuf_iterator, rebuilt from scratch.
+static void legacy_create_jar(const std::filesystem::path& output_jar, const std::vector<JarInput>& inputs)
+{
+    struct archive* a = archive_write_new();
+    archive_write_set_format_zip(a);
+    archive_write_open_filename(a, output_jar.c_str());
+    for (const JarInput& input : inputs) {
+        std::ifstream file(input.path, std::ios::binary);
+        std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        struct archive_entry* entry = archive_entry_new();
+        archive_entry_set_pathname(entry, input.name.c_str());
+        archive_entry_set_size(entry, buffer.size());
+        archive_entry_set_filetype(entry, AE_IFREG);
+        archive_entry_set_perm(entry, 0644);
+        archive_write_header(a, entry);
+        archive_write_data(a, buffer.data(), buffer.size());
+        archive_entry_free(entry);
+    }
+    archive_write_close(a);
+    archive_write_free(a);
+}
+
+// Class-file-sized inputs with the kind of repetition real bytecode has.
+static std::vector<JarInput> generate_classes(const std::filesystem::path& root, int count)
+{
+    std::mt19937 random(42);
+    std::vector<JarInput> inputs;
+    for (int i = 0; i < count; i++) {
+        std::string name = "pkg" + std::to_string(i % 40) + "/Class" + std::to_string(i) + ".class";
+        std::filesystem::path path = root / name;
+        std::filesystem::create_directories(path.parent_path());
+        std::string body = "\xCA\xFE\xBA\xBE";
+        size_t size = 512 + random() % 8192;
+        while (body.size() < size) body += "java/lang/Object" + std::to_string(random() % 64) + "()V";
+        std::ofstream(path, std::ios::binary) << body;
+        inputs.push_back({name, path});
+    }
+    return inputs;
+}
+
+int bench_jar(int argc, char** argv)
+{
+    int classes = 3000;
+    int runs = 3;
+    for (int i = 0; i + 1 < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--classes") classes = std::stoi(argv[++i]);
+        else if (arg == "--runs") runs = std::stoi(argv[++i]);
+    }
+    std::filesystem::path scratch = std::filesystem::temp_directory_path() / ("myjvm-bench-" + std::to_string(getpid()));
+    std::vector<JarInput> inputs = generate_classes(scratch / "classes", classes);
+    std::filesystem::path jar = scratch / "all_files.jar";
+    double legacy = 0;
+    double full = 0;
+    double unchanged = 0;
+    double one_changed = 0;
+    for (int run = 0; run < runs; run++) {
+        std::filesystem::remove(jar);
+        legacy += time_seconds([&] { legacy_create_jar(jar, inputs); });
+        std::filesystem::remove(jar);
+        full += time_seconds([&] { write_jar(jar, inputs, {}); });
+        unchanged += time_seconds([&] { update_jar(jar, inputs, {}); });
+        std::ofstream(inputs[run % inputs.size()].path, std::ios::binary | std::ios::app) << "changed";
+        one_changed += time_seconds([&] { update_jar(jar, inputs, {}); });
+    }
+    std::filesystem::remove_all(scratch);
+    cout << "jar " << classes << " classes (" << runs << " runs)" << endl;
+    cout << "  legacy:            " << legacy / runs << " s" << endl;
+    cout << "  write_jar:         " << full / runs << " s" << endl;
+    cout << "  update, unchanged: " << unchanged / runs << " s" << endl;
+    cout << "  update, 1 changed: " << one_changed / runs << " s" << endl;
+    return 0;
+}
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "../src/classfile.hpp"
+#include "../src/prewarm.hpp"
+#include "../src/project.hpp"
+#include "../src/runtime.hpp"
+#include "../src/utils.hpp"
+#include "bench.hpp"
+
+using std::cout;
+using std::endl;
+
+// End-to-end timings of one build and run, phase by phase, over generated
+// projects of increasing size. Sources are the test/ project (Person,
+// Student, MainProgram) with Student cloned until the project has the
+// requested number of classes. Runtimes go to a private store so the first
+// language measured pays for a cold extraction; pass --store to reuse one.
+
+struct GeneratedFile
+{
+    std::string name;
+    std::string contents;
+};
+
+static std::string student_name(int i)
+{
+    return "Student" + std::to_string(i);
+}
+
+// Students are constructed by MainProgram; only the first few, so the run
+// phase stays comparable across scales.
+static const int CONSTRUCTED_STUDENTS = 10;
+
+static std::vector<GeneratedFile> java_project(int classes)
+{
+    std::vector<GeneratedFile> files;
+    std::ostringstream main;
+    main << "public class MainProgram {\n    public static void main(String[] args) {\n";
+    if (classes == 1) main << "        System.out.println(\"Hi, I'm Alice and I'm 20 years old.\");\n";
+    else if (classes == 2) main << "        new Person(\"Alice\", 20).introduce();\n";
+    for (int i = 0; i < std::min(classes - 2, CONSTRUCTED_STUDENTS); i++) {
+        main << "        new " << student_name(i) << "(\"Alice\", 20, \"Computer Science\").introduce();\n";
+    }
+    main << "    }\n}\n";
+    files.push_back({"MainProgram.java", main.str()});
+    if (classes < 2) return files;
+    files.push_back({"Person.java", R"(public class Person {
+    private String name;
+    private int age;
+
+    public Person(String name, int age) {
+        this.name = name;
+        this.age = age;
+    }
+
+    public void introduce() {
+        System.out.println("Hi, I'm " + name + " and I'm " + age + " years old.");
+    }
+}
+)"});
+    for (int i = 0; i < classes - 2; i++) {
+        std::string name = student_name(i);
+        files.push_back({name + ".java", "public class " + name + R"( extends Person {
+    private String major;
+
+    public )" + name + R"((String name, int age, String major) {
+        super(name, age);
+        this.major = major;
+    }
+
+    @Override
+    public void introduce() {
+        super.introduce();
+        System.out.println("I'm studying " + major + ".");
+    }
+}
+)"});
+    }
+    return files;
+}
+
+static std::vector<GeneratedFile> scala_project(int classes)
+{
+    std::vector<GeneratedFile> files;
+    std::ostringstream main;
+    main << "package example\n\nobject MainProgram {\n  def main(args: Array[String]): Unit = {\n";
+    if (classes == 1) main << "    println(\"Hello, my name is Charlie and I am 19 years old.\")\n";
+    else if (classes == 2) main << "    new Person(\"Charlie\", 19).greet()\n";
+    for (int i = 0; i < std::min(classes - 2, CONSTRUCTED_STUDENTS); i++) {
+        main << "    new " << student_name(i) << "(\"Charlie\", 19, \"Physics\").study()\n";
+    }
+    main << "  }\n}\n";
+    files.push_back({"MainProgram.scala", main.str()});
+    if (classes < 2) return files;
+    files.push_back({"Person.scala", R"(package example
+
+class Person(val name: String, val age: Int) {
+  def greet(): Unit = {
+    println(s"Hello, my name is $name and I am $age years old.")
+  }
+}
+)"});
+    for (int i = 0; i < classes - 2; i++) {
+        std::string name = student_name(i);
+        files.push_back({name + ".scala", "package example\n\nclass " + name + R"((name: String, age: Int, val major: String) extends Person(name, age) {
+  def study(): Unit = {
+    println(s"I am studying $major.")
+  }
+}
+)"});
+    }
+    return files;
+}
+
+// There is no Kotlin sample in test/; this is the same project written in Kotlin.
+static std::vector<GeneratedFile> kotlin_project(int classes)
+{
+    std::vector<GeneratedFile> files;
+    std::ostringstream main;
+    main << "package example\n\nfun main() {\n";
+    if (classes == 1) main << "    println(\"Hi, I'm Dana and I'm 21 years old.\")\n";
+    else if (classes == 2) main << "    Person(\"Dana\", 21).introduce()\n";
+    for (int i = 0; i < std::min(classes - 2, CONSTRUCTED_STUDENTS); i++) {
+        main << "    " << student_name(i) << "(\"Dana\", 21, \"Biology\").introduce()\n";
+    }
+    main << "}\n";
+    files.push_back({"MainProgram.kt", main.str()});
+    if (classes < 2) return files;
+    files.push_back({"Person.kt", R"(package example
+
+open class Person(val name: String, val age: Int) {
+    open fun introduce() {
+        println("Hi, I'm $name and I'm $age years old.")
+    }
+}
+)"});
+    for (int i = 0; i < classes - 2; i++) {
+        std::string name = student_name(i);
+        files.push_back({name + ".kt", "package example\n\nclass " + name + R"((name: String, age: Int, val major: String) : Person(name, age) {
+    override fun introduce() {
+        super.introduce()
+        println("I'm studying $major.")
+    }
+}
+)"});
+    }
+    return files;
+}
+
+static void generate_project(const std::filesystem::path& root, const std::string& language, int classes)
+{
+    std::vector<GeneratedFile> files;
+    if (language == "java") files = java_project(classes);
+    else if (language == "scala") files = scala_project(classes);
+    else files = kotlin_project(classes);
+    std::filesystem::create_directories(root);
+    for (const GeneratedFile& file : files) std::ofstream(root / file.name) << file.contents;
+}
+
+// Phase name -> one sample per run; a phase that does not apply to a
+// language has no samples.
+using PhaseTimes = std::map<std::string, std::vector<double>>;
+
+static const std::vector<std::string> PHASES = {"extract", "prewarm", "discover", "compile", "jar", "entry_point", "run", "rerun"};
+
+// One build and run from a clean out/. "compile" is compile_files as a
+// build runs it, which includes writing the jar; "jar"
+// then times create_jar_from_classes again from scratch on its own. "run" is
+// the first launch after a compile, which also dumps the AppCDS archive;
+// "rerun" launches again with it.
+static bool measure_run(const std::string& language, PhaseTimes& times)
+{
+    std::filesystem::remove_all("out");
+    std::filesystem::create_directories("out");
+    std::vector<std::string> installed;
+    times["extract"].push_back(time_seconds([&] { installed = ensure_runtime(runtime_components(infer_file_type("."))); }));
+    if (!installed.empty()) times["prewarm"].push_back(time_seconds([&] { prewarm_components(installed); }));
+    std::string filetype;
+    std::vector<std::string> files;
+    invalidate_project_index();
+    times["discover"].push_back(time_seconds([&] {
+        filetype = infer_file_type(".");
+        files = find_source_files(".");
+    }));
+    bool compiled = false;
+    times["compile"].push_back(time_seconds([&] { compiled = compile_files(files, filetype); }));
+    if (!compiled) {
+        std::cerr << "Compiling the " << language << " project failed." << endl;
+        return false;
+    }
+    std::filesystem::path layer = runtime_library_layer(filetype);
+    std::filesystem::remove("out/all_files.jar");
+    times["jar"].push_back(time_seconds([&] { create_jar_from_classes(get_class_files(), layer); }));
+    std::vector<std::string> entry_points;
+    times["entry_point"].push_back(time_seconds([&] { entry_points = find_entry_points(get_class_files()); }));
+    if (entry_points.empty()) {
+        std::cerr << "No entry point found in the " << language << " project." << endl;
+        return false;
+    }
+    int status = 0;
+    times["run"].push_back(time_seconds([&] { status = run_known_class_file(entry_points[0], filetype); }));
+    if (status != 0) return false;
+    times["rerun"].push_back(time_seconds([&] { status = run_known_class_file(entry_points[0], filetype); }));
+    return status == 0;
+}
+
+static std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+static std::string json_escape(const std::string& text)
+{
+    std::string out;
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') out += '\\';
+        out += ch;
+    }
+    return out;
+}
+
+int bench_phases(int argc, char** argv)
+{
+    std::vector<std::string> languages = {"java", "scala", "kotlin"};
+    std::vector<int> scales = {1, 100, 1000, 10000};
+    int runs = 1;
+    std::string json_path = "bench-phases.json";
+    std::string store;
+    bool keep = false;
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--keep") keep = true;
+        else if (i + 1 >= argc) break;
+        else if (arg == "--languages") languages = split_list(argv[++i]);
+        else if (arg == "--scales") {
+            scales.clear();
+            for (const std::string& scale : split_list(argv[++i])) scales.push_back(std::stoi(scale));
+        }
+        else if (arg == "--runs") runs = std::stoi(argv[++i]);
+        else if (arg == "--json") json_path = argv[++i];
+        else if (arg == "--store") store = argv[++i];
+    }
+    std::filesystem::path start_dir = std::filesystem::current_path();
+    json_path = std::filesystem::absolute(json_path).string();
+    std::filesystem::path scratch = std::filesystem::temp_directory_path() / ("myjvm-bench-phases-" + std::to_string(getpid()));
+    // runtime_dir() is fixed on first use, so this has to happen before anything touches the store.
+    if (store.empty()) store = (scratch / "store").string();
+    setenv("MYJVM_HOME", std::filesystem::absolute(store).c_str(), 1);
+    std::ostringstream json;
+    json << "{\n  \"suite\": \"phases\",\n  \"runs\": " << runs << ",\n  \"store\": \"" << json_escape(runtime_dir().string()) << "\",\n  \"results\": [";
+    bool first_result = true;
+    int status = 0;
+    for (const std::string& language : languages) {
+        if (language != "java" && language != "scala" && language != "kotlin") {
+            std::cerr << "Unknown language: " << language << endl;
+            return 1;
+        }
+        for (int classes : scales) {
+            std::filesystem::path project = scratch / (language + "-" + std::to_string(classes));
+            generate_project(project, language, classes);
+            std::filesystem::current_path(project);
+            PhaseTimes times;
+            bool ok = true;
+            for (int run = 0; run < runs && ok; run++) ok = measure_run(language, times);
+            std::filesystem::current_path(start_dir);
+            if (!keep) std::filesystem::remove_all(project);
+            if (!ok) status = 1;
+            cout << language << ", " << classes << " classes" << (ok ? "" : " (failed)") << endl;
+            json << (first_result ? "" : ",") << "\n    {\"language\": \"" << language << "\", \"classes\": " << classes
+                 << ", \"ok\": " << (ok ? "true" : "false") << ", \"phases\": {";
+            first_result = false;
+            bool first_phase = true;
+            for (const std::string& phase : PHASES) {
+                const std::vector<double>& samples = times[phase];
+                json << (first_phase ? "" : ", ") << "\"" << phase << "\": ";
+                first_phase = false;
+                if (samples.empty()) {
+                    json << "null";
+                    continue;
+                }
+                std::vector<double> sorted = samples;
+                std::sort(sorted.begin(), sorted.end());
+                double median = sorted[sorted.size() / 2];
+                cout << "  " << phase << ": " << median << " s" << endl;
+                json << "{\"median\": " << median << ", \"min\": " << sorted.front() << ", \"samples\": [";
+                for (size_t i = 0; i < samples.size(); i++) json << (i ? ", " : "") << samples[i];
+                json << "]}";
+            }
+            json << "}}";
+        }
+    }
+    json << "\n  ]\n}\n";
+    std::ofstream(json_path) << json.str();
+    cout << "Wrote " << json_path << endl;
+    if (!keep) std::filesystem::remove_all(scratch);
+    return status;
+}
@@ -0,0 +1,86 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "../src/walker.hpp"
+#include "bench.hpp"
+
+using std::cout;
+using std::endl;
+
+// find_source_files as it was before the walker: one stat-backed iterator
+// over the whole tree.
+static size_t legacy_walk(const std::filesystem::path& root)
+{
+    size_t count = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+        if (!entry.is_regular_file()) continue;
+        if (entry.path().extension() == ".java") count++;
+    }
+    return count;
+}
+
+static size_t walker_count(const std::filesystem::path& root, size_t threads)
+{
+    WalkOptions options;
+    options.threads = threads;
+    size_t count = 0;
+    for (const std::string& file : walk_files(root, options)) {
+        if (file.ends_with(".java")) count++;
+    }
+    return count;
+}
+
+// Empty files, 100 to a directory, three levels deep, a tenth of them
+// something other than Java.
+static void generate_tree(const std::filesystem::path& root, int files)
+{
+    for (int i = 0; i < files; i++) {
+        std::filesystem::path dir = root / ("d" + std::to_string(i / 10000)) / ("d" + std::to_string(i / 100 % 100));
+        if (i % 100 == 0) std::filesystem::create_directories(dir);
+        std::ofstream(dir / ("F" + std::to_string(i) + (i % 10 == 0 ? ".txt" : ".java")));
+    }
+}
+
+int bench_walk(int argc, char** argv)
+{
+    int files = 500000;
+    int runs = 3;
+    std::filesystem::path tree;
+    for (int i = 0; i + 1 < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--files") files = std::stoi(argv[++i]);
+        else if (arg == "--runs") runs = std::stoi(argv[++i]);
+        else if (arg == "--tree") tree = argv[++i];
+    }
+    bool generated = tree.empty();
+    if (generated) {
+        tree = std::filesystem::temp_directory_path() / ("myjvm-bench-walk-" + std::to_string(getpid()));
+        cout << "Generating " << files << " files..." << endl;
+        generate_tree(tree, files);
+    }
+    double legacy = 0;
+    double serial = 0;
+    double parallel = 0;
+    size_t expected = 0;
+    bool consistent = true;
+    for (int run = 0; run < runs; run++) {
+        legacy += time_seconds([&] { expected = legacy_walk(tree); });
+        size_t found = 0;
+        serial += time_seconds([&] { found = walker_count(tree, 1); });
+        consistent = consistent && found == expected;
+        parallel += time_seconds([&] { found = walker_count(tree, 0); });
+        consistent = consistent && found == expected;
+    }
+    if (generated) std::filesystem::remove_all(tree);
+    cout << "walk " << tree.string() << " (" << expected << " sources, " << runs << " runs)" << endl;
+    cout << "  recursive_directory_iterator: " << legacy / runs << " s" << endl;
+    cout << "  walk_files, 1 thread:         " << serial / runs << " s" << endl;
+    cout << "  walk_files, all cores:        " << parallel / runs << " s" << endl;
+    if (!consistent) {
+        std::cerr << "walk_files found a different number of sources." << endl;
+        return 1;
+    }
+    return 0;
+}
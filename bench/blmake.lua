@@ -0,0 +1,21 @@
+-- Config file generated by blmake!
+-- All tables expect string values. Leave empty if unused.
+-- `debugging` expects a boolean value.
+-- Everything else expects a string value. Use "" if unused.
+
+Build = {
+    compiler = "g++",      -- e.g., "g++"
+    files = {"bench/bench.cpp", "bench/bench_extract.cpp", "bench/bench_jar.cpp", "bench/bench_phases.cpp", "bench/bench_walk.cpp", "src/classfile.cpp", "src/daemon.cpp", "src/extractor.cpp", "src/integrity.cpp", "src/jar.cpp", "src/langpack.cpp", "src/manifest.cpp", "src/os.cpp", "src/prewarm.cpp", "src/project.cpp", "src/runtime.cpp", "src/scheduler.cpp", "src/trace.cpp", "src/utils.cpp", "src/walker.cpp", "src/lang_archive.o"}, -- e.g., {"main.cpp", "utils.cpp"}
+    lang_exts = {"-std=c++20"},     -- e.g., {"-std=c++20"}
+    include_dirs = {},  -- Directories for include files (optional)
+    linker_opts = {},   -- Paths to check for included dependencies
+    dependencies = {"archive", "zstd", "xxhash", "z", "pthread"},  -- Libraries to link against, e.g. {"lib1", "lib2"}
+    preproc_opts = {},  -- Preprocessor options (e.g., macros, include paths)
+    optimization = "-O3",  -- Optimization level (e.g., "-O2", "-Os")
+    debugging = false,  -- A BOOLEAN value indicating whether to include debugging info ("-g")
+    build_type = "",    -- e.g., "Debug" or "Release"
+    output = "myjvm_bench",        -- e.g., "myprogram"
+    src_dir = "..",       -- Source directory
+    out_dir = "../build",       -- Output directory
+    hooks = {},         -- e.g., {pre_build = "scripts/pre_build.sh"} 
+}
@@ -5,11 +5,11 @@
 
 Build = {
     compiler = "g++",      -- e.g., "g++"
-    files = {"main.cpp", "os.cpp", "utils.cpp", "lang_archive.o"}, -- e.g., {"main.cpp", "utils.cpp"}
+    files = {"main.cpp", "batch.cpp", "classfile.cpp", "daemon.cpp", "extractor.cpp", "integrity.cpp", "jar.cpp", "langpack.cpp", "manifest.cpp", "os.cpp", "prewarm.cpp", "project.cpp", "runtime.cpp", "scheduler.cpp", "trace.cpp", "utils.cpp", "walker.cpp", "watch.cpp", "lang_archive.o"}, -- e.g., {"main.cpp", "utils.cpp"}
     lang_exts = {"-std=c++20"},     -- e.g., {"-std=c++20"}
     include_dirs = {},  -- Directories for include files (optional)
     linker_opts = {},   -- Paths to check for included dependencies
-    dependencies = {"archive", "zstd"},  -- Libraries to link against, e.g. {"lib1", "lib2"}
+    dependencies = {"archive", "zstd", "xxhash", "z", "pthread"},  -- Libraries to link against, e.g. {"lib1", "lib2"}
     preproc_opts = {},  -- Preprocessor options (e.g., macros, include paths)
     optimization = "-O3",  -- Optimization level (e.g., "-O2", "-Os")
     debugging = false,  -- A BOOLEAN value indicating whether to include debugging info ("-g")
@@ -1,6 +1,14 @@
 #!/bin/bash
 
-tar -cf .languages.tar .languages
-zstd .languages.tar
+mkdir -p build
+g++ -std=c++20 -O3 tools/langpack.cpp src/langpack.cpp -larchive -lzstd -lxxhash -lpthread -o build/langpack
+# One tar per runtime component so each can be extracted on its own.
+components=()
+for dir in .languages/*/; do
+    name=$(basename "$dir")
+    tar -cf ".languages-$name.tar" ".languages/$name"
+    components+=("$name=.languages-$name.tar")
+done
+./build/langpack .languages.tar.zst "${components[@]}"
 ld -r -b binary .languages.tar.zst -o src/lang_archive.o 
-rm -f .langauges.tar
+rm -f .languages-*.tar
@@ -1,7 +1,8 @@
 #!/bin/bash
 
 unzstd .languages.tar.zst
-tar -xf .languages.tar
+# The pack is several component tars back to back.
+tar --ignore-zeros -xf .languages.tar
 
 rm -rf .languages.tar*
 
@@ -0,0 +1,447 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "batch.hpp"
+#include "os.hpp"
+#include "prewarm.hpp"
+#include "project.hpp"
+#include "runtime.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include "utils.hpp"
+
+#if OS_UNIX_LIKE_DEFINED
+    #include <poll.h>
+#endif
+#if defined(OS_LINUX)
+    #include <sched.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+// Where a job leaves its outcome for the batch, inside its project.
+static const std::filesystem::path RESULT_PATH = "out/.myjvm-batch-result";
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs in the project directory, started by the batch as `myjvm batch --job`.
+// The outcome is written to RESULT_PATH rather than folded into the exit
+// status, which belongs to the program.
+int run_batch_job(const std::string& main_class)
+{
+    std::string status = "error";
+    int exit_code = 1;
+    double compile_seconds = 0;
+    double run_seconds = 0;
+    // A timeout sends SIGTERM first; finish through main so the trace is written.
+    OS::catch_stop_signals();
+    std::string filetype = infer_file_type(".");
+    if (filetype == "UNKNOWN") std::cerr << "No Java, Scala or Kotlin sources found." << endl;
+    else {
+        ensure_runtime(runtime_components(filetype));
+        auto start = std::chrono::steady_clock::now();
+        bool built = build_project(find_source_files("."), filetype);
+        compile_seconds = seconds_since(start);
+        if (!built) status = "compile_failed";
+        else if (OS::stop_requested()) status = "timeout";
+        else {
+            start = std::chrono::steady_clock::now();
+            if (main_class.empty()) exit_code = run_detected_entry_point(filetype);
+            else exit_code = run_known_class_file(main_class, filetype);
+            run_seconds = seconds_since(start);
+            status = exit_code == 0 ? "ok" : "run_failed";
+            if (OS::stop_requested()) status = "timeout";
+        }
+    }
+    std::filesystem::create_directories(RESULT_PATH.parent_path());
+    std::ofstream result(RESULT_PATH);
+    result << "status " << status << '\n'
+           << "exit_code " << exit_code << '\n'
+           << "compile_seconds " << compile_seconds << '\n'
+           << "run_seconds " << run_seconds << '\n';
+    if (OS::stop_requested()) return 1;
+    return exit_code == 0 ? 0 : 1;
+}
+
+#if OS_UNIX_LIKE_DEFINED
+// Room for one compiler JVM: its heap, plus metaspace, code cache and threads.
+static const uint64_t MIN_JOB_MEMORY = 768ull << 20;
+static const size_t REPORT_OUTPUT_BYTES = 4 << 10;
+// How long a timed-out job gets after SIGTERM to wind down before SIGKILL.
+static const double STOP_GRACE_SECONDS = 2;
+
+struct BatchProject
+{
+    std::filesystem::path path;
+    std::string main_class;
+};
+
+struct BatchResult
+{
+    std::string status = "error";  // "ok", "compile_failed", "run_failed", "timeout" or "error"
+    int exit_code = -1;  // the program's, or the job's if it never ran
+    double compile_seconds = 0;
+    double run_seconds = 0;
+    double seconds = 0;
+    std::string output;  // the end of the job's stdout and stderr
+};
+
+struct BatchLimits
+{
+    size_t cores = 1;
+    uint64_t memory = 0;  // bytes, 0 if unknown
+    size_t jobs = 1;
+    std::string xmx;  // per-JVM heap cap, "" for the JVM's default
+};
+
+#if defined(OS_LINUX)
+// The cgroup (v2) this process belongs to.
+static std::filesystem::path cgroup_dir()
+{
+    std::ifstream file("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.starts_with("0::/") && line.size() > 4) return std::filesystem::path("/sys/fs/cgroup") / line.substr(4);
+    }
+    return "/sys/fs/cgroup";
+}
+
+// The lowest value of `name` ("max" meaning none) from our cgroup up to the root.
+static std::optional<uint64_t> cgroup_limit(const std::string& name)
+{
+    std::optional<uint64_t> limit;
+    for (std::filesystem::path dir = cgroup_dir(); ; dir = dir.parent_path()) {
+        std::ifstream file(dir / name);
+        std::string value;
+        if (file >> value && value != "max") {
+            uint64_t bytes = std::strtoull(value.c_str(), nullptr, 10);
+            if (!limit || bytes < *limit) limit = bytes;
+        }
+        if (dir == "/sys/fs/cgroup" || dir == dir.parent_path()) break;
+    }
+    return limit;
+}
+#endif
+
+// Usable CPUs: the affinity mask, capped by a cgroup CPU quota.
+static size_t available_cores()
+{
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    #if defined(OS_LINUX)
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) cores = std::max(1, CPU_COUNT(&set));
+        std::ifstream cpu_max(cgroup_dir() / "cpu.max");
+        std::string quota;
+        uint64_t period = 0;
+        if (cpu_max >> quota >> period && quota != "max" && period > 0) {
+            uint64_t allowed = (std::strtoull(quota.c_str(), nullptr, 10) + period - 1) / period;
+            cores = std::clamp<size_t>(allowed, 1, cores);
+        }
+    #endif
+    return cores;
+}
+
+// Memory the jobs may use: what is available, capped by the cgroup limit
+// minus what the cgroup already uses. 0 if neither is known.
+static uint64_t memory_budget()
+{
+    uint64_t budget = 0;
+    #if defined(OS_LINUX)
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        uint64_t kilobytes;
+        std::string unit;
+        while (meminfo >> key >> kilobytes >> unit) {
+            if (key != "MemAvailable:") continue;
+            budget = kilobytes << 10;
+            break;
+        }
+        std::optional<uint64_t> limit = cgroup_limit("memory.max");
+        if (limit) {
+            uint64_t used = 0;
+            std::ifstream(cgroup_dir() / "memory.current") >> used;
+            uint64_t left = *limit > used ? *limit - used : 0;
+            budget = budget ? std::min(budget, left) : left;
+        }
+    #endif
+    return budget;
+}
+
+// One job per core as long as each keeps MIN_JOB_MEMORY; a job runs one JVM
+// at a time, and half of its share goes to that JVM's heap.
+static BatchLimits plan_limits(size_t jobs_override)
+{
+    BatchLimits limits;
+    limits.cores = available_cores();
+    limits.memory = memory_budget();
+    limits.jobs = limits.cores;
+    if (limits.memory) limits.jobs = std::clamp<size_t>(limits.memory / MIN_JOB_MEMORY, 1, limits.cores);
+    if (jobs_override) limits.jobs = jobs_override;
+    const char* xmx = std::getenv("MYJVM_XMX");
+    if (xmx && *xmx) limits.xmx = xmx;
+    else if (limits.memory) {
+        uint64_t megabytes = std::max<uint64_t>(64, (limits.memory / limits.jobs / 2) >> 20);
+        limits.xmx = std::to_string(megabytes) + "m";
+    }
+    return limits;
+}
+
+static std::vector<BatchProject> read_manifest(const std::filesystem::path& manifest)
+{
+    std::vector<BatchProject> projects;
+    std::ifstream file(manifest);
+    if (!file) {
+        std::cerr << "Unable to read " << manifest.string() << endl;
+        return projects;
+    }
+    std::filesystem::path base = std::filesystem::absolute(manifest).parent_path();
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        BatchProject project;
+        std::string path;
+        if (!(fields >> path) || path.starts_with("#")) continue;
+        fields >> project.main_class;
+        project.path = (base / path).lexically_normal();
+        projects.push_back(std::move(project));
+    }
+    return projects;
+}
+
+static BatchResult run_job(const std::filesystem::path& self, const BatchProject& project, int timeout_seconds)
+{
+    TraceScope trace("batch_job");
+    trace.arg("project", project.path.string());
+    BatchResult result;
+    auto start = std::chrono::steady_clock::now();
+    if (!std::filesystem::is_directory(project.path)) {
+        result.output = "No such directory.";
+        return result;
+    }
+    std::error_code ec;
+    std::filesystem::remove(project.path / RESULT_PATH, ec);
+    std::vector<std::string> args = {self.string(), "batch", "--job"};
+    if (!project.main_class.empty()) args.push_back(project.main_class);
+    // A group of its own, so a timeout also stops the JVMs the job started.
+    Process child = OS::spawn(args, Stdio::Pipe, Stdio::MergeWithStdout, project.path, true);
+    if (!child.valid()) {
+        result.output = "Unable to start " + self.string() + ".";
+        return result;
+    }
+    OutputTail tail(REPORT_OUTPUT_BYTES);
+    bool timed_out = false;
+    char buffer[8192];
+    while (true) {
+        int wait_ms = -1;
+        if (timeout_seconds > 0) {
+            double left = timeout_seconds + (timed_out ? STOP_GRACE_SECONDS : 0) - seconds_since(start);
+            if (left <= 0 && timed_out) {
+                child.kill_group();
+                break;
+            }
+            if (left <= 0) {
+                // SIGTERM lets the job write its trace; SIGKILL follows if it lingers.
+                timed_out = true;
+                child.kill_group(SIGTERM);
+                continue;
+            }
+            wait_ms = static_cast<int>(left * 1000) + 1;
+        }
+        pollfd pfd = {child.stdout_fd(), POLLIN, 0};
+        int ready = poll(&pfd, 1, wait_ms);
+        if (ready == -1 && errno == EINTR) continue;
+        if (ready <= 0) {
+            if (ready == -1) break;
+            continue;
+        }
+        ssize_t n = read(child.stdout_fd(), buffer, sizeof(buffer));
+        if (n <= 0) break;
+        tail.append(buffer, n);
+    }
+    result.exit_code = child.wait();
+    result.output = tail.str();
+    result.seconds = seconds_since(start);
+    trace.arg("status", result.exit_code);
+    if (timed_out) {
+        result.status = "timeout";
+        return result;
+    }
+    std::ifstream file(project.path / RESULT_PATH);
+    std::string key;
+    while (file >> key) {
+        if (key == "status") file >> result.status;
+        else if (key == "exit_code") file >> result.exit_code;
+        else if (key == "compile_seconds") file >> result.compile_seconds;
+        else if (key == "run_seconds") file >> result.run_seconds;
+        else file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return result;
+}
+
+static std::string json_string(const std::string& text)
+{
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if (c == '\n') out += "\\n";
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else out += c;
+    }
+    return out + "\"";
+}
+
+static bool write_report(const std::filesystem::path& path, const std::filesystem::path& manifest, const BatchLimits& limits,
+                         const std::vector<BatchProject>& projects, const std::vector<BatchResult>& results, double seconds)
+{
+    std::map<std::string, size_t> counts;
+    for (const BatchResult& result : results) counts[result.status]++;
+    std::ofstream json(path);
+    json << "{\n  \"manifest\": " << json_string(std::filesystem::absolute(manifest).string())
+         << ",\n  \"cores\": " << limits.cores
+         << ",\n  \"memory_budget\": " << limits.memory
+         << ",\n  \"jobs\": " << limits.jobs
+         << ",\n  \"xmx\": " << json_string(limits.xmx)
+         << ",\n  \"seconds\": " << seconds
+         << ",\n  \"projects_per_second\": " << (seconds > 0 ? projects.size() / seconds : 0)
+         << ",\n  \"summary\": {";
+    for (auto it = counts.begin(); it != counts.end(); it++) {
+        json << (it == counts.begin() ? "" : ", ") << json_string(it->first) << ": " << it->second;
+    }
+    json << "},\n  \"projects\": [";
+    for (size_t i = 0; i < projects.size(); i++) {
+        const BatchResult& result = results[i];
+        json << (i ? "," : "") << "\n    {\"path\": " << json_string(projects[i].path.string())
+             << ", \"main_class\": " << json_string(projects[i].main_class)
+             << ", \"status\": " << json_string(result.status)
+             << ", \"exit_code\": " << result.exit_code
+             << ", \"compile_seconds\": " << result.compile_seconds
+             << ", \"run_seconds\": " << result.run_seconds
+             << ", \"seconds\": " << result.seconds
+             << ", \"output\": " << json_string(result.output) << "}";
+    }
+    json << "\n  ]\n}\n";
+    return static_cast<bool>(json);
+}
+
+static std::filesystem::path self_path(const char* argv0)
+{
+    std::error_code ec;
+    std::filesystem::path self = std::filesystem::read_symlink("/proc/self/exe", ec);
+    if (!ec) return self;
+    return std::filesystem::absolute(argv0);
+}
+
+static const char* BATCH_USAGE = "Usage: myjvm batch <manifest> [--jobs N] [--timeout SECONDS] [--report FILE]";
+
+int run_batch_command(const char* argv0, const std::vector<std::string>& args)
+{
+    std::filesystem::path manifest;
+    std::filesystem::path report = "myjvm-batch.json";
+    size_t jobs = 0;
+    int timeout_seconds = 0;
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        bool has_value = i + 1 < args.size();
+        if (arg == "--jobs" && has_value) jobs = std::strtoul(args[++i].c_str(), nullptr, 10);
+        else if (arg == "--timeout" && has_value) timeout_seconds = std::atoi(args[++i].c_str());
+        else if (arg == "--report" && has_value) report = args[++i];
+        else if (manifest.empty() && !arg.starts_with("--")) manifest = arg;
+        else {
+            std::cerr << BATCH_USAGE << endl;
+            return 1;
+        }
+    }
+    if (manifest.empty()) {
+        std::cerr << BATCH_USAGE << endl;
+        return 1;
+    }
+    std::vector<BatchProject> projects = read_manifest(manifest);
+    if (projects.empty()) {
+        std::cerr << "No projects listed in " << manifest.string() << endl;
+        return 1;
+    }
+
+    // Install every runtime the projects need up front, so the jobs only
+    // verify the store instead of racing to fill it.
+    std::set<std::string> components;
+    for (const BatchProject& project : projects) {
+        if (!std::filesystem::is_directory(project.path)) continue;
+        for (const std::string& component : runtime_components(infer_file_type(project.path))) components.insert(component);
+    }
+    invalidate_project_index();
+    ensure_runtime({components.begin(), components.end()});
+    prewarm_components({components.begin(), components.end()});
+
+    BatchLimits limits = plan_limits(jobs);
+    limits.jobs = std::min(limits.jobs, projects.size());
+    // The budget counts one JVM per job, so each project compiles on one core,
+    // in its own compiler: a shared daemon would serialise every job's
+    // compiles and ignore the per-job heap.
+    setenv("MYJVM_JOBS", "1", 1);
+    setenv("MYJVM_DAEMON", "0", 1);
+    if (!limits.xmx.empty()) setenv("MYJVM_XMX", limits.xmx.c_str(), 1);
+    cout << "Running " << projects.size() << " project(s), " << limits.jobs << " at a time";
+    if (!limits.xmx.empty()) cout << ", -Xmx" << limits.xmx << " per JVM";
+    cout << "." << endl;
+
+    std::filesystem::path self = self_path(argv0);
+    std::vector<BatchResult> results(projects.size());
+    std::mutex print_mutex;
+    size_t finished = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(limits.jobs);
+        std::vector<std::future<void>> pending;
+        for (size_t i = 0; i < projects.size(); i++) {
+            pending.push_back(pool.submit([&, i] {
+                results[i] = run_job(self, projects[i], timeout_seconds);
+                std::lock_guard<std::mutex> lock(print_mutex);
+                char seconds[32];
+                std::snprintf(seconds, sizeof(seconds), "%.2fs", results[i].seconds);
+                cout << "[" << ++finished << "/" << projects.size() << "] " << projects[i].path.string()
+                     << ": " << results[i].status << " (" << seconds << ")" << endl;
+            }));
+        }
+        for (std::future<void>& done : pending) done.get();
+    }
+    double seconds = seconds_since(start);
+    if (!write_report(report, manifest, limits, projects, results, seconds)) {
+        std::cerr << "Unable to write " << report.string() << endl;
+        return 1;
+    }
+    size_t ok = std::count_if(results.begin(), results.end(), [](const BatchResult& result) { return result.status == "ok"; });
+    cout << ok << "/" << projects.size() << " project(s) succeeded in " << seconds << "s. Report: " << report.string() << endl;
+    return ok == projects.size() ? 0 : 1;
+}
+#else
+int run_batch_command(const char* argv0, const std::vector<std::string>& args)
+{
+    std::cerr << "Batch mode is only available on Unix-like systems." << endl;
+    return 1;
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// `myjvm batch <manifest>`: builds and runs many projects side by side. The
+// manifest lists a project directory per line, optionally followed by the
+// class to run; blank lines and lines starting with '#' are skipped, and
+// relative paths are taken from the manifest's directory. Each project runs
+// in a child myjvm started in that directory, so every project keeps its
+// own out/ while the runtime store is set up once and shared. How many run
+// at once follows the usable cores and the memory budget (the cgroup limit,
+// or the available memory), and each job's JVMs get an even share of that
+// budget through MYJVM_XMX. Every project's outcome goes into a JSON report.
+
+int run_batch_command(const char* argv0, const std::vector<std::string>& args);
+int run_batch_job(const std::string& main_class);
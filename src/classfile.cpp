@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "classfile.hpp"
+#include "manifest.hpp"
+#include "os.hpp"
+
+namespace
+{
+    enum ConstantTag : uint8_t
+    {
+        CONSTANT_Utf8 = 1,
+        CONSTANT_Integer = 3,
+        CONSTANT_Float = 4,
+        CONSTANT_Long = 5,
+        CONSTANT_Double = 6,
+        CONSTANT_Class = 7,
+        CONSTANT_String = 8,
+        CONSTANT_Fieldref = 9,
+        CONSTANT_Methodref = 10,
+        CONSTANT_InterfaceMethodref = 11,
+        CONSTANT_NameAndType = 12,
+        CONSTANT_MethodHandle = 15,
+        CONSTANT_MethodType = 16,
+        CONSTANT_Dynamic = 17,
+        CONSTANT_InvokeDynamic = 18,
+        CONSTANT_Module = 19,
+        CONSTANT_Package = 20,
+    };
+
+    struct Constant
+    {
+        uint8_t tag = 0;
+        uint16_t index = 0;     // Class/String: utf8 index
+        uint64_t value = 0;     // Integer/Float/Long/Double raw bits
+        std::string_view utf8;
+    };
+
+    class Reader
+    {
+    private:
+        const uint8_t* m_data;
+        size_t m_size;
+        size_t m_pos = 0;
+    public:
+        Reader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+        inline void need(size_t n) const
+        {
+            if (m_pos + n > m_size) throw std::out_of_range("Truncated class file");
+        }
+        inline uint8_t u1() { need(1); return m_data[m_pos++]; }
+        inline uint16_t u2()
+        {
+            need(2);
+            uint16_t v = (m_data[m_pos] << 8) | m_data[m_pos + 1];
+            m_pos += 2;
+            return v;
+        }
+        inline uint32_t u4()
+        {
+            uint32_t hi = u2();
+            return (hi << 16) | u2();
+        }
+        inline std::string_view bytes(size_t n)
+        {
+            need(n);
+            std::string_view v(reinterpret_cast<const char*>(m_data + m_pos), n);
+            m_pos += n;
+            return v;
+        }
+        inline void skip(size_t n) { need(n); m_pos += n; }
+    };
+
+    std::string_view utf8_at(const std::vector<Constant>& pool, uint16_t index)
+    {
+        if (index == 0 || index >= pool.size() || pool[index].tag != CONSTANT_Utf8) {
+            throw std::out_of_range("Bad constant pool reference");
+        }
+        return pool[index].utf8;
+    }
+
+    std::string class_at(const std::vector<Constant>& pool, uint16_t index)
+    {
+        if (index == 0) return "";
+        if (index >= pool.size() || pool[index].tag != CONSTANT_Class) {
+            throw std::out_of_range("Bad class reference");
+        }
+        return std::string(utf8_at(pool, pool[index].index));
+    }
+
+    std::string render_constant(const std::vector<Constant>& pool, uint16_t index)
+    {
+        if (index == 0 || index >= pool.size()) return "";
+        const Constant& c = pool[index];
+        switch (c.tag) {
+            case CONSTANT_Integer: return "I" + std::to_string(static_cast<int32_t>(c.value));
+            case CONSTANT_Long: return "J" + std::to_string(static_cast<int64_t>(c.value));
+            case CONSTANT_Float: return "F" + std::to_string(c.value);
+            case CONSTANT_Double: return "D" + std::to_string(c.value);
+            case CONSTANT_String: return "S" + std::string(utf8_at(pool, c.index));
+            default: return "";
+        }
+    }
+
+    // Collects every `Lpkg/Name;` type mentioned in a descriptor or signature.
+    void collect_descriptor_types(std::string_view text, std::vector<std::string>& out)
+    {
+        size_t pos = 0;
+        while ((pos = text.find('L', pos)) != std::string_view::npos) {
+            size_t end = text.find_first_of(";<", pos);
+            if (end == std::string_view::npos) break;
+            std::string_view name = text.substr(pos + 1, end - pos - 1);
+            if (!name.empty() && name.find_first_of("()[ ") == std::string_view::npos) out.emplace_back(name);
+            pos = end;
+        }
+    }
+
+    ClassMember read_member(Reader& r, const std::vector<Constant>& pool)
+    {
+        ClassMember member;
+        member.access = r.u2();
+        member.name = utf8_at(pool, r.u2());
+        member.descriptor = utf8_at(pool, r.u2());
+        uint16_t attribute_count = r.u2();
+        for (uint16_t i = 0; i < attribute_count; i++) {
+            std::string_view attribute = utf8_at(pool, r.u2());
+            uint32_t length = r.u4();
+            if (attribute == "Signature" && length == 2) member.signature = utf8_at(pool, r.u2());
+            else if (attribute == "ConstantValue" && length == 2) member.constant = render_constant(pool, r.u2());
+            else r.skip(length);
+        }
+        return member;
+    }
+
+    // Reads the magic, version and constant pool, leaving `r` at the
+    // class's access flags.
+    bool read_header(Reader& r, std::vector<Constant>& pool)
+    {
+        if (r.u4() != 0xCAFEBABE) return false;
+        r.u2(); // minor
+        r.u2(); // major
+        uint16_t pool_count = r.u2();
+        pool.assign(pool_count, Constant());
+        for (uint16_t i = 1; i < pool_count; i++) {
+            Constant& c = pool[i];
+            c.tag = r.u1();
+            switch (c.tag) {
+                case CONSTANT_Utf8: c.utf8 = r.bytes(r.u2()); break;
+                case CONSTANT_Integer:
+                case CONSTANT_Float: c.value = r.u4(); break;
+                case CONSTANT_Long:
+                case CONSTANT_Double: {
+                    uint64_t high = r.u4();
+                    c.value = (high << 32) | r.u4();
+                    i++; // 8-byte constants occupy two slots
+                    break;
+                }
+                case CONSTANT_Class:
+                case CONSTANT_String:
+                case CONSTANT_MethodType:
+                case CONSTANT_Module:
+                case CONSTANT_Package: c.index = r.u2(); break;
+                case CONSTANT_MethodHandle: r.skip(3); break;
+                case CONSTANT_Fieldref:
+                case CONSTANT_Methodref:
+                case CONSTANT_InterfaceMethodref:
+                case CONSTANT_NameAndType:
+                case CONSTANT_Dynamic:
+                case CONSTANT_InvokeDynamic: r.skip(4); break;
+                default: return false;
+            }
+        }
+        return true;
+    }
+
+    void skip_attributes(Reader& r)
+    {
+        uint16_t attribute_count = r.u2();
+        for (uint16_t i = 0; i < attribute_count; i++) {
+            r.u2();
+            r.skip(r.u4());
+        }
+    }
+}
+
+std::optional<ClassFile> parse_class_file(const uint8_t* data, size_t size)
+{
+    try {
+        Reader r(data, size);
+        std::vector<Constant> pool;
+        if (!read_header(r, pool)) return std::nullopt;
+        ClassFile cls;
+        cls.access = r.u2();
+        cls.name = class_at(pool, r.u2());
+        cls.super_name = class_at(pool, r.u2());
+        uint16_t interface_count = r.u2();
+        for (uint16_t i = 0; i < interface_count; i++) cls.interfaces.push_back(class_at(pool, r.u2()));
+        uint16_t field_count = r.u2();
+        for (uint16_t i = 0; i < field_count; i++) cls.fields.push_back(read_member(r, pool));
+        uint16_t method_count = r.u2();
+        for (uint16_t i = 0; i < method_count; i++) cls.methods.push_back(read_member(r, pool));
+        uint16_t attribute_count = r.u2();
+        for (uint16_t i = 0; i < attribute_count; i++) {
+            std::string_view attribute = utf8_at(pool, r.u2());
+            uint32_t length = r.u4();
+            if (attribute == "SourceFile" && length == 2) cls.source_file = utf8_at(pool, r.u2());
+            else if (attribute == "Signature" && length == 2) cls.signature = utf8_at(pool, r.u2());
+            else r.skip(length);
+        }
+        for (const Constant& c : pool) {
+            if (c.tag == CONSTANT_Class) {
+                std::string_view name = utf8_at(pool, c.index);
+                if (name.starts_with('[')) collect_descriptor_types(name, cls.referenced_classes);
+                else cls.referenced_classes.emplace_back(name);
+            }
+            else if (c.tag == CONSTANT_Utf8) collect_descriptor_types(c.utf8, cls.referenced_classes);
+        }
+        std::sort(cls.referenced_classes.begin(), cls.referenced_classes.end());
+        cls.referenced_classes.erase(std::unique(cls.referenced_classes.begin(), cls.referenced_classes.end()), cls.referenced_classes.end());
+        std::erase(cls.referenced_classes, cls.name);
+        return cls;
+    }
+    catch (const std::out_of_range&) {
+        return std::nullopt;
+    }
+}
+
+std::optional<ClassFile> parse_class_file(const std::filesystem::path& path)
+{
+    MappedFile file(path);
+    if (!file.ok()) return std::nullopt;
+    return parse_class_file(file.data(), file.size());
+}
+
+// Walks only the constant pool and the method table, without building a
+// ClassFile. Any `public static void main(String[])` counts, which covers
+// javac output, Scala objects' static forwarders and Kotlin's FileKt
+// classes (whose no-argument main gets a synthetic String[] bridge).
+std::optional<std::string> find_main_class(const uint8_t* data, size_t size)
+{
+    try {
+        Reader r(data, size);
+        std::vector<Constant> pool;
+        if (!read_header(r, pool)) return std::nullopt;
+        r.u2(); // access
+        std::string name = class_at(pool, r.u2());
+        r.u2(); // super
+        r.skip(r.u2() * 2);
+        uint16_t field_count = r.u2();
+        for (uint16_t i = 0; i < field_count; i++) {
+            r.skip(6);
+            skip_attributes(r);
+        }
+        uint16_t method_count = r.u2();
+        for (uint16_t i = 0; i < method_count; i++) {
+            uint16_t access = r.u2();
+            std::string_view method_name = utf8_at(pool, r.u2());
+            std::string_view descriptor = utf8_at(pool, r.u2());
+            if ((access & (ACC_PUBLIC | ACC_STATIC)) == (ACC_PUBLIC | ACC_STATIC) && 
+                method_name == "main" && descriptor == "([Ljava/lang/String;)V") {
+                return name;
+            }
+            skip_attributes(r);
+        }
+        return std::nullopt;
+    }
+    catch (const std::out_of_range&) {
+        return std::nullopt;
+    }
+}
+
+std::optional<std::string> find_main_class(const std::filesystem::path& path)
+{
+    MappedFile file(path);
+    if (!file.ok()) return std::nullopt;
+    return find_main_class(file.data(), file.size());
+}
+
+// Entry points among `class_files`, as binary names ("example.Main"),
+// sorted.
+std::vector<std::string> find_entry_points(const std::vector<std::string>& class_files)
+{
+    std::vector<std::string> result;
+    for (const std::string& file : class_files) {
+        std::optional<std::string> name = find_main_class(std::filesystem::path(file));
+        if (!name) continue;
+        std::replace(name->begin(), name->end(), '/', '.');
+        result.push_back(*name);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// Only what other classes can compile against contributes: private members
+// and method bodies are left out, so editing an implementation keeps the
+// fingerprint stable. Package-private members count since same-package
+// dependents can see them.
+uint64_t abi_fingerprint(const ClassFile& cls)
+{
+    const uint16_t member_mask = 0x0001 | 0x0004 | 0x0008 | 0x0010 | 0x0400 | 0x4000;
+    std::vector<std::string> parts;
+    for (const ClassMember& field : cls.fields) {
+        if (field.access & ACC_PRIVATE) continue;
+        parts.push_back("F " + std::to_string(field.access & member_mask) + " " + field.name + " " + field.descriptor + " " + field.signature + " " + field.constant);
+    }
+    for (const ClassMember& method : cls.methods) {
+        if ((method.access & ACC_PRIVATE) || method.name == "<clinit>") continue;
+        parts.push_back("M " + std::to_string(method.access & member_mask) + " " + method.name + " " + method.descriptor + " " + method.signature);
+    }
+    std::sort(parts.begin(), parts.end());
+    std::vector<std::string> interfaces = cls.interfaces;
+    std::sort(interfaces.begin(), interfaces.end());
+    std::string canonical = std::to_string(cls.access) + " " + cls.name + " " + cls.super_name + " " + cls.signature + "\n";
+    for (const std::string& name : interfaces) canonical += "I " + name + "\n";
+    for (const std::string& part : parts) canonical += part + "\n";
+    return hash_bytes(canonical.data(), canonical.size());
+}
+
+// javac inlines compile-time constants into their users, leaving no
+// reference behind, so changes to them need to be detected separately.
+uint64_t constants_fingerprint(const ClassFile& cls)
+{
+    std::vector<std::string> parts;
+    for (const ClassMember& field : cls.fields) {
+        if (!field.constant.empty()) parts.push_back(field.name + "=" + field.constant);
+    }
+    if (parts.empty()) return 0;
+    std::sort(parts.begin(), parts.end());
+    std::string canonical;
+    for (const std::string& part : parts) canonical += part + "\n";
+    return hash_bytes(canonical.data(), canonical.size());
+}
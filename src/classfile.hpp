@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Minimal reader for the JVM class file format: enough of the constant pool,
+// member tables and attributes to fingerprint a class's API and to find the
+// classes it refers to, and to find entry points, without starting a JVM.
+
+constexpr uint16_t ACC_PUBLIC    = 0x0001;
+constexpr uint16_t ACC_PRIVATE   = 0x0002;
+constexpr uint16_t ACC_PROTECTED = 0x0004;
+constexpr uint16_t ACC_STATIC    = 0x0008;
+constexpr uint16_t ACC_FINAL     = 0x0010;
+constexpr uint16_t ACC_SYNTHETIC = 0x1000;
+
+struct ClassMember
+{
+    uint16_t access;
+    std::string name;
+    std::string descriptor;
+    std::string signature;  // generic signature, if any
+    std::string constant;   // ConstantValue of a static final field, rendered as text
+};
+
+struct ClassFile
+{
+    uint16_t access;
+    std::string name;  // internal form, e.g. "example/Student"
+    std::string super_name;
+    std::vector<std::string> interfaces;
+    std::string signature;
+    std::string source_file;
+    std::vector<ClassMember> fields;
+    std::vector<ClassMember> methods;
+    std::vector<std::string> referenced_classes;  // sorted, without duplicates
+};
+
+std::optional<ClassFile> parse_class_file(const uint8_t* data, size_t size);
+std::optional<ClassFile> parse_class_file(const std::filesystem::path& path);
+uint64_t abi_fingerprint(const ClassFile& cls);
+uint64_t constants_fingerprint(const ClassFile& cls);
+std::optional<std::string> find_main_class(const uint8_t* data, size_t size);
+std::optional<std::string> find_main_class(const std::filesystem::path& path);
+std::vector<std::string> find_entry_points(const std::vector<std::string>& class_files);
@@ -0,0 +1,358 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "daemon.hpp"
+#include "manifest.hpp"
+#include "os.hpp"
+#include "runtime.hpp"
+#include "utils.hpp"
+
+#if OS_UNIX_LIKE_DEFINED
+    #include <fcntl.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+// Server side of the daemon. It is compiled with the bundled javac the first
+// time a daemon is started. Requests are NUL-separated argument lists sent
+// over the socket, terminated by the client shutting down its write half.
+// Responses are "<exit code>\n<compiler output>".
+static const char* COMPILE_DAEMON_SOURCE = R"JAVA(
+import java.io.*;
+import java.net.StandardProtocolFamily;
+import java.net.UnixDomainSocketAddress;
+import java.nio.ByteBuffer;
+import java.nio.channels.*;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.*;
+import java.util.*;
+
+public class CompileDaemon {
+    // dotc reports through scala.Console, which captures System.err the first
+    // time it is touched, so the process-wide streams are installed once and
+    // retargeted for each request instead of being swapped.
+    static final class Redirect extends OutputStream {
+        volatile OutputStream target = OutputStream.nullOutputStream();
+        @Override public void write(int b) throws IOException { target.write(b); }
+        @Override public void write(byte[] b, int off, int len) throws IOException { target.write(b, off, len); }
+        @Override public void flush() throws IOException { target.flush(); }
+    }
+
+    static final Redirect REDIRECT = new Redirect();
+
+    public static void main(String[] args) throws Exception {
+        Path socket = Path.of(args[0]);
+        String language = args[1];
+        PrintStream log = System.err;
+        PrintStream shared = new PrintStream(REDIRECT, true, StandardCharsets.UTF_8);
+        System.setOut(shared);
+        System.setErr(shared);
+        Files.deleteIfExists(socket);
+        try (ServerSocketChannel server = ServerSocketChannel.open(StandardProtocolFamily.UNIX)) {
+            server.bind(UnixDomainSocketAddress.of(socket));
+            boolean running = true;
+            while (running) {
+                try (SocketChannel client = server.accept()) {
+                    running = handle(client, language);
+                }
+                catch (Exception e) {
+                    e.printStackTrace(log);
+                }
+            }
+        }
+        finally {
+            Files.deleteIfExists(socket);
+        }
+    }
+
+    static boolean handle(SocketChannel client, String language) throws Exception {
+        ByteArrayOutputStream request = new ByteArrayOutputStream();
+        ByteBuffer buffer = ByteBuffer.allocate(1 << 16);
+        while (client.read(buffer) >= 0) {
+            buffer.flip();
+            request.write(buffer.array(), 0, buffer.limit());
+            buffer.clear();
+        }
+        List<String> parts = new ArrayList<>(Arrays.asList(request.toString(StandardCharsets.UTF_8).split("\0", -1)));
+        String command = parts.remove(0);
+        if (command.equals("shutdown")) {
+            reply(client, 0, "");
+            return false;
+        }
+        if (command.equals("ping")) {
+            reply(client, 0, language);
+            return true;
+        }
+        ByteArrayOutputStream output = new ByteArrayOutputStream();
+        int code;
+        synchronized (REDIRECT) {
+            REDIRECT.target = output;
+            try {
+                code = compile(language, parts.toArray(new String[0]), new PrintStream(output, true, StandardCharsets.UTF_8));
+            }
+            catch (Throwable t) {
+                t.printStackTrace(new PrintStream(output, true, StandardCharsets.UTF_8));
+                code = 1;
+            }
+            finally {
+                System.out.flush();
+                System.err.flush();
+                REDIRECT.target = OutputStream.nullOutputStream();
+            }
+        }
+        reply(client, code, output.toString(StandardCharsets.UTF_8));
+        return true;
+    }
+
+    static int compile(String language, String[] args, PrintStream out) throws Exception {
+        if (language.equals("java")) {
+            return javax.tools.ToolProvider.getSystemJavaCompiler().run(null, out, out, args);
+        }
+        if (language.equals("kotlin")) {
+            // A fresh CLI compiler per request; kotlin.environment.keepalive
+            // keeps its application environment warm between them.
+            Object compiler = Class.forName("org.jetbrains.kotlin.cli.jvm.K2JVMCompiler").getDeclaredConstructor().newInstance();
+            Object exitCode = compiler.getClass().getMethod("exec", PrintStream.class, String[].class).invoke(compiler, out, (Object) args);
+            return (Integer) exitCode.getClass().getMethod("getCode").invoke(exitCode);
+        }
+        Class<?> main = Class.forName("dotty.tools.dotc.Main");
+        Object reporter = main.getMethod("process", String[].class).invoke(null, (Object) args);
+        boolean errors = (Boolean) reporter.getClass().getMethod("hasErrors").invoke(reporter);
+        return errors ? 1 : 0;
+    }
+
+    static void reply(SocketChannel client, int code, String output) throws IOException {
+        ByteBuffer response = ByteBuffer.wrap((code + "\n" + output).getBytes(StandardCharsets.UTF_8));
+        while (response.hasRemaining()) client.write(response);
+    }
+}
+)JAVA";
+
+static std::filesystem::path daemon_directory()
+{
+    std::filesystem::path dir;
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir) dir = std::filesystem::path(runtime_dir) / "myjvm";
+    #if OS_UNIX_LIKE_DEFINED
+    else dir = std::filesystem::temp_directory_path() / ("myjvm-" + std::to_string(getuid()));
+    #else
+    else dir = std::filesystem::temp_directory_path() / "myjvm";
+    #endif
+    std::filesystem::create_directories(dir);
+    std::filesystem::permissions(dir, std::filesystem::perms::owner_all, std::filesystem::perm_options::replace);
+    return dir;
+}
+
+static std::string daemon_version()
+{
+    char version[20];
+    std::snprintf(version, sizeof(version), "%016llx", static_cast<unsigned long long>(hash_bytes(COMPILE_DAEMON_SOURCE, std::strlen(COMPILE_DAEMON_SOURCE))));
+    return version;
+}
+
+// Daemons are told apart by the store their compilers come from and by the
+// daemon source, so after an upgrade or a MYJVM_HOME change a daemon from
+// another store is never handed this store's compiles.
+static std::string daemon_name(const std::string& language)
+{
+    std::string identity = runtime_dir().string() + "\n" + daemon_version();
+    char name[40];
+    std::snprintf(name, sizeof(name), "-%016llx", static_cast<unsigned long long>(hash_bytes(identity.data(), identity.size())));
+    return language + name;
+}
+
+std::filesystem::path daemon_socket_path(const std::string& language)
+{
+    return daemon_directory() / (daemon_name(language) + ".sock");
+}
+
+#if OS_UNIX_LIKE_DEFINED
+static int connect_daemon(const std::string& language)
+{
+    std::string path = daemon_socket_path(language).string();
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) return -1;
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static std::optional<std::pair<int, std::string>> daemon_request(const std::string& language, const std::vector<std::string>& parts)
+{
+    int fd = connect_daemon(language);
+    if (fd == -1) return std::nullopt;
+    std::string request;
+    for (size_t i = 0; i < parts.size(); i++) {
+        if (i > 0) request += '\0';
+        request += parts[i];
+    }
+    size_t written = 0;
+    while (written < request.size()) {
+        ssize_t n = send(fd, request.data() + written, request.size() - written, MSG_NOSIGNAL);
+        if (n <= 0) {
+            close(fd);
+            return std::nullopt;
+        }
+        written += n;
+    }
+    shutdown(fd, SHUT_WR);
+    std::string response;
+    char buffer[65536];
+    ssize_t bytes_read;
+    while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
+        response.append(buffer, bytes_read);
+    }
+    close(fd);
+    // A daemon that dies mid-request sends nothing; let the caller fall back.
+    size_t newline = response.find('\n');
+    if (newline == std::string::npos) return std::nullopt;
+    int code = std::atoi(response.substr(0, newline).c_str());
+    return std::make_pair(code, response.substr(newline + 1));
+}
+#else
+static std::optional<std::pair<int, std::string>> daemon_request(const std::string&, const std::vector<std::string>&)
+{
+    return std::nullopt;
+}
+#endif
+
+bool daemon_running(const std::string& language)
+{
+    return daemon_request(language, {"ping"}).has_value();
+}
+
+std::optional<std::pair<int, std::string>> daemon_compile(const std::string& language, const std::vector<std::string>& args)
+{
+    std::vector<std::string> parts = {"compile"};
+    parts.insert(parts.end(), args.begin(), args.end());
+    return daemon_request(language, parts);
+}
+
+static bool build_daemon_classes(const std::filesystem::path& class_dir)
+{
+    if (std::filesystem::exists(class_dir / "CompileDaemon.class")) return true;
+    // Build in a staging directory since the runtime store is shared.
+    std::filesystem::path staging = class_dir;
+    staging += ".tmp-" + std::to_string(getpid());
+    std::filesystem::create_directories(staging);
+    std::filesystem::path source = staging / "CompileDaemon.java";
+    std::ofstream ofs(source);
+    if (!ofs) {
+        std::cerr << "Unable to write daemon source: " << source << endl;
+        return false;
+    }
+    ofs << COMPILE_DAEMON_SOURCE;
+    ofs.close();
+    std::vector<std::string> command = {
+        runtime_path("jvm-runtime-standard/bin/javac").string(),
+        "-d", staging.string(),
+        source.string()
+    };
+    std::pair<int, std::string> res = OS::run_command(command);
+    if (res.first != 0) {
+        std::cerr << "Unable to compile daemon: " << res.second << endl;
+        std::filesystem::remove_all(staging);
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(staging, class_dir, ec);
+    if (ec) std::filesystem::remove_all(staging);  // another process got there first
+    return std::filesystem::exists(class_dir / "CompileDaemon.class");
+}
+
+bool start_daemon(const std::string& language)
+{
+    if (daemon_running(language)) return true;
+    // Named after the source, so a changed daemon is rebuilt rather than reused.
+    std::filesystem::path class_dir = runtime_path("compile-daemon/" + daemon_version());
+    if (!build_daemon_classes(class_dir)) return false;
+    std::string java_path = runtime_path("jvm-runtime-standard/bin/java").string();
+    std::vector<std::string> args = {java_path};
+    std::string classpath = class_dir.string();
+    if (language == "scala") {
+        args.push_back("-Dscala.usejavacp=true");
+        classpath += ":" + scala_compiler_classpath();
+    }
+    else if (language == "kotlin") {
+        args.insert(args.end(), {"-Dkotlin.home=" + runtime_path("kotlin-compiler/kotlinc").string(),
+                                 "-Dkotlin.environment.keepalive=true", "-Xss2m"});
+        classpath += ":" + kotlin_compiler_classpath();
+    }
+    args.insert(args.end(), {"-cp", classpath, "CompileDaemon", daemon_socket_path(language).string(), language});
+    #if OS_UNIX_LIKE_DEFINED
+    std::string log_path = (daemon_directory() / (daemon_name(language) + ".log")).string();
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork failed");
+        return false;
+    }
+    if (pid == 0) {
+        // Detach from the terminal so the daemon outlives this invocation.
+        setsid();
+        int null_fd = open("/dev/null", O_RDONLY);
+        int log_fd = open(log_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0600);
+        if (null_fd != -1) dup2(null_fd, STDIN_FILENO);
+        if (log_fd != -1) {
+            dup2(log_fd, STDOUT_FILENO);
+            dup2(log_fd, STDERR_FILENO);
+        }
+        std::vector<char*> cargs;
+        for (std::string& arg : args) cargs.push_back(arg.data());
+        cargs.push_back(nullptr);
+        execv(cargs[0], cargs.data());
+        _exit(EXIT_FAILURE);
+    }
+    for (int attempt = 0; attempt < 100; attempt++) {
+        if (daemon_running(language)) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    std::cerr << "Daemon for " << language << " did not come up. See " << log_path << endl;
+    #endif
+    return false;
+}
+
+bool stop_daemon(const std::string& language)
+{
+    return daemon_request(language, {"shutdown"}).has_value();
+}
+
+int run_daemon_command(const std::string& action)
+{
+    const std::vector<std::string> languages = {"java", "scala", "kotlin"};
+    if (action == "start") {
+        int failures = 0;
+        for (const std::string& language : languages) {
+            if (start_daemon(language)) cout << language << " daemon listening on " << daemon_socket_path(language).string() << endl;
+            else failures++;
+        }
+        return failures == 0 ? 0 : 1;
+    }
+    else if (action == "stop") {
+        for (const std::string& language : languages) {
+            if (stop_daemon(language)) cout << language << " daemon stopped." << endl;
+        }
+        return 0;
+    }
+    else if (action == "status") {
+        for (const std::string& language : languages) {
+            cout << language << ": " << (daemon_running(language) ? "running" : "stopped") << endl;
+        }
+        return 0;
+    }
+    std::cerr << "Usage: myjvm daemon [start|stop|status]" << endl;
+    return 1;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Warm compiler daemon: one long-lived JVM per language, reachable over a
+// Unix socket, that compiles in-process instead of paying JVM startup on
+// every build. Supported languages are "java", "scala" and "kotlin". The
+// socket is named after the runtime store, so each store has its own daemons.
+
+std::filesystem::path daemon_socket_path(const std::string& language);
+bool daemon_running(const std::string& language);
+std::optional<std::pair<int, std::string>> daemon_compile(const std::string& language, const std::vector<std::string>& args);
+bool start_daemon(const std::string& language);
+bool stop_daemon(const std::string& language);
+int run_daemon_command(const std::string& action);
@@ -0,0 +1,176 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "extractor.hpp"
+#include "os.hpp"
+
+#if OS_UNIX_LIKE_DEFINED
+    #include <fcntl.h>
+    #include <sys/stat.h>
+#endif
+#ifdef MYJVM_IO_URING
+    #include <liburing.h>
+#endif
+
+// Batches are handed over once they hold this many files or bytes, which
+// keeps per-task overhead low for the thousands of tiny runtime files.
+static const size_t BATCH_FILES = 64;
+static const size_t BATCH_BYTES = 8 << 20;
+
+#if OS_UNIX_LIKE_DEFINED
+static int create_file(const PendingFile& file)
+{
+    int fd = open(file.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, file.mode);
+    if (fd == -1) {
+        throw std::runtime_error("Failed to create output file: " + file.path.string() + ": " + strerror(errno));
+    }
+    #if defined(OS_LINUX)
+    // Best effort: not every filesystem supports preallocation.
+    if (!file.body.empty()) fallocate(fd, 0, 0, file.body.size());
+    #endif
+    return fd;
+}
+
+static void write_remaining(int fd, const PendingFile& file, size_t written)
+{
+    while (written < file.body.size()) {
+        ssize_t n = pwrite(fd, file.body.data() + written, file.body.size() - written, written);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Failed to write " + file.path.string() + ": " + strerror(errno));
+        written += n;
+    }
+}
+
+#ifdef MYJVM_IO_URING
+// Submits the whole batch's writes at once; returns false when io_uring is
+// unavailable so the caller can fall back to plain writes.
+static bool write_batch_uring(const std::vector<PendingFile>& batch, const std::vector<int>& fds)
+{
+    struct Ring
+    {
+        io_uring ring;
+        bool ok;
+        Ring() { ok = io_uring_queue_init(BATCH_FILES, &ring, 0) == 0; }
+        ~Ring() { if (ok) io_uring_queue_exit(&ring); }
+    };
+    thread_local Ring ring;
+    if (!ring.ok) return false;
+    std::vector<size_t> written(batch.size(), 0);
+    unsigned submitted = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (batch[i].body.empty()) continue;
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring.ring);
+        if (!sqe) break;
+        io_uring_prep_write(sqe, fds[i], batch[i].body.data(), batch[i].body.size(), 0);
+        sqe->user_data = i;
+        submitted++;
+    }
+    if (submitted > 0 && io_uring_submit_and_wait(&ring.ring, submitted) < 0) return false;
+    for (unsigned i = 0; i < submitted; i++) {
+        io_uring_cqe* cqe;
+        if (io_uring_wait_cqe(&ring.ring, &cqe) < 0) break;
+        if (cqe->res > 0) written[cqe->user_data] = cqe->res;
+        io_uring_cqe_seen(&ring.ring, cqe);
+    }
+    // Short or failed writes, and anything that did not fit in the ring,
+    // are finished synchronously.
+    for (size_t i = 0; i < batch.size(); i++) write_remaining(fds[i], batch[i], written[i]);
+    return true;
+}
+#endif
+
+static void write_batch(const std::vector<PendingFile>& batch)
+{
+    std::vector<int> fds;
+    fds.reserve(batch.size());
+    try {
+        for (const PendingFile& file : batch) fds.push_back(create_file(file));
+        bool done = false;
+        #ifdef MYJVM_IO_URING
+        done = write_batch_uring(batch, fds);
+        #endif
+        if (!done) {
+            for (size_t i = 0; i < batch.size(); i++) write_remaining(fds[i], batch[i], 0);
+        }
+    }
+    catch (...) {
+        for (int fd : fds) close(fd);
+        throw;
+    }
+    for (int fd : fds) close(fd);
+}
+#else
+static void write_batch(const std::vector<PendingFile>& batch)
+{
+    for (const PendingFile& file : batch) {
+        std::ofstream out(file.path, std::ios::binary);
+        if (!out) throw std::runtime_error("Failed to create output file: " + file.path.string());
+        out.write(file.body.data(), file.body.size());
+    }
+}
+#endif
+
+ExtractionWriter::ExtractionWriter(size_t threads) : m_pool(threads)
+{
+}
+
+void ExtractionWriter::ensure_parent(const std::filesystem::path& path)
+{
+    std::filesystem::path parent = path.parent_path();
+    if (parent.empty() || m_directories.contains(parent.string())) return;
+    std::filesystem::create_directories(parent);
+    m_directories.insert(parent.string());
+}
+
+void ExtractionWriter::add_directory(const std::filesystem::path& path, mode_t mode)
+{
+    ensure_parent(path);
+    #if OS_UNIX_LIKE_DEFINED
+    // Keep the owner able to write into it while the tree is being filled.
+    if (mkdir(path.c_str(), mode | S_IRWXU) == -1 && errno != EEXIST) {
+        throw std::runtime_error("Failed to create directory: " + path.string() + ": " + strerror(errno));
+    }
+    #else
+    std::filesystem::create_directories(path);
+    #endif
+    m_directories.insert(path.string());
+}
+
+void ExtractionWriter::add_file(PendingFile file)
+{
+    ensure_parent(file.path);
+    m_batch_bytes += file.body.size();
+    m_batch.push_back(std::move(file));
+    if (m_batch.size() >= BATCH_FILES || m_batch_bytes >= BATCH_BYTES) flush();
+}
+
+void ExtractionWriter::add_symlink(const std::filesystem::path& path, const std::string& target)
+{
+    ensure_parent(path);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    std::filesystem::create_symlink(target, path);
+}
+
+void ExtractionWriter::flush()
+{
+    if (m_batch.empty()) return;
+    // Bound memory by waiting on the oldest batch once every writer is busy.
+    while (m_inflight.size() >= m_pool.size() * 2) {
+        m_inflight.front().get();
+        m_inflight.pop_front();
+    }
+    m_inflight.push_back(m_pool.submit([batch = std::move(m_batch)] { write_batch(batch); }));
+    m_batch.clear();
+    m_batch_bytes = 0;
+}
+
+void ExtractionWriter::finish()
+{
+    flush();
+    while (!m_inflight.empty()) {
+        m_inflight.front().get();
+        m_inflight.pop_front();
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <string>
+#include <sys/types.h>
+#include <unordered_set>
+#include <vector>
+#include "thread_pool.hpp"
+
+// Extraction backend for the runtime archive. The reading thread creates
+// directories and symlinks itself and hands file bodies, in batches, to a
+// pool of writer threads. Writers create each file with its final mode,
+// preallocate it with fallocate and write it in one go, through io_uring
+// when built with MYJVM_IO_URING and the kernel supports it.
+
+struct PendingFile
+{
+    std::filesystem::path path;
+    mode_t mode;
+    std::vector<char> body;
+};
+
+class ExtractionWriter
+{
+private:
+    // Fields
+    ThreadPool m_pool;
+    std::deque<std::future<void>> m_inflight;
+    std::vector<PendingFile> m_batch;
+    size_t m_batch_bytes = 0;
+    std::unordered_set<std::string> m_directories;
+
+    void ensure_parent(const std::filesystem::path& path);
+    void flush();
+public:
+    explicit ExtractionWriter(size_t threads = 0);
+    void add_directory(const std::filesystem::path& path, mode_t mode);
+    void add_file(PendingFile file);
+    void add_symlink(const std::filesystem::path& path, const std::string& target);
+    void finish();
+};
@@ -0,0 +1,192 @@
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include "integrity.hpp"
+#include "manifest.hpp"
+#include "os.hpp"
+#include "runtime.hpp"
+#include "thread_pool.hpp"
+
+using std::cout;
+using std::endl;
+
+static const std::string INTEGRITY_HEADER = "myjvm-integrity 1";
+static const uint32_t TYPE_MASK = 0170000;
+static const uint32_t TYPE_DIRECTORY = 0040000;
+static const uint32_t TYPE_SYMLINK = 0120000;
+static const uint32_t OWNER_EXEC = 0100;
+
+using IntegrityRecord = std::unordered_map<std::string, ManifestEntry>;
+
+static std::filesystem::path record_path(const std::string& component)
+{
+    return runtime_path(component + ".integrity");
+}
+
+// Pack entries belonging to `component`, named relative to the store.
+static std::vector<PackEntry> component_entries(const std::string& component)
+{
+    std::vector<PackEntry> entries;
+    const SeekableArchive* pack = embedded_pack();
+    if (!pack) return entries;
+    std::string root = LANGUAGES_PREFIX + component + "/";
+    for (const PackEntry& entry : pack->entries()) {
+        if (!entry.path.starts_with(root)) continue;
+        PackEntry relative = entry;
+        relative.path.erase(0, LANGUAGES_PREFIX.size());
+        entries.push_back(std::move(relative));
+    }
+    return entries;
+}
+
+static IntegrityRecord load_record(const std::string& component)
+{
+    IntegrityRecord record;
+    std::ifstream file(record_path(component));
+    std::string line;
+    if (!file || !std::getline(file, line) || line != INTEGRITY_HEADER) return record;
+    while (std::getline(file, line)) {
+        // Same layout as the build manifest: <hash hex> <size> <mtime> <path>.
+        std::istringstream fields(line);
+        ManifestEntry entry;
+        std::string path;
+        if (!(fields >> std::hex >> entry.hash >> std::dec >> entry.size >> entry.mtime)) continue;
+        fields.get();
+        std::getline(fields, path);
+        if (!path.empty()) record[path] = entry;
+    }
+    return record;
+}
+
+static void save_record(const std::string& component, const IntegrityRecord& record)
+{
+    std::filesystem::path path = record_path(component);
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp-" + std::to_string(getpid());
+    {
+        std::ofstream file(temp_path, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Unable to write runtime integrity record: " << temp_path << endl;
+            return;
+        }
+        file << INTEGRITY_HEADER << '\n';
+        for (const auto& [entry_path, entry] : record) {
+            file << std::hex << entry.hash << std::dec << ' ' << entry.size << ' ' << entry.mtime << ' ' << entry_path << '\n';
+        }
+    }
+    std::filesystem::rename(temp_path, path);
+}
+
+IntegrityReport verify_component(const std::string& component, bool rehash)
+{
+    IntegrityReport report;
+    std::vector<PackEntry> entries = component_entries(component);
+    if (entries.empty()) return report;
+    std::filesystem::path store = runtime_dir();
+    IntegrityRecord record = load_record(component);
+    IntegrityRecord verified;
+    std::vector<std::pair<const PackEntry*, ManifestEntry>> to_hash;
+    for (const PackEntry& entry : entries) {
+        report.checked++;
+        std::filesystem::path path = store / entry.path;
+        std::error_code ec;
+        std::filesystem::file_status status = std::filesystem::symlink_status(path, ec);
+        uint32_t type = entry.mode & TYPE_MASK;
+        if (type == TYPE_DIRECTORY) {
+            if (status.type() != std::filesystem::file_type::directory) report.damaged.push_back(entry.path);
+            continue;
+        }
+        if (type == TYPE_SYMLINK) {
+            std::string target = status.type() == std::filesystem::file_type::symlink ? std::filesystem::read_symlink(path, ec).string() : "";
+            if (ec || hash_bytes(target.data(), target.size()) != entry.hash) report.damaged.push_back(entry.path);
+            continue;
+        }
+        if (status.type() != std::filesystem::file_type::regular) {
+            report.damaged.push_back(entry.path);
+            continue;
+        }
+        bool executable = (status.permissions() & std::filesystem::perms::owner_exec) != std::filesystem::perms::none;
+        ManifestEntry seen = {entry.hash, std::filesystem::file_size(path, ec), 0};
+        if (!ec) seen.mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        if (ec || seen.size != entry.size || ((entry.mode & OWNER_EXEC) && !executable)) {
+            report.damaged.push_back(entry.path);
+            continue;
+        }
+        auto it = record.find(entry.path);
+        if (!rehash && it != record.end() && it->second.hash == entry.hash && 
+            it->second.size == seen.size && it->second.mtime == seen.mtime) {
+            verified[entry.path] = seen;
+            continue;
+        }
+        to_hash.push_back({&entry, seen});
+    }
+    if (!to_hash.empty()) {
+        ThreadPool pool;
+        std::vector<std::future<uint64_t>> hashes;
+        for (const auto& [entry, seen] : to_hash) {
+            std::filesystem::path path = store / entry->path;
+            hashes.push_back(pool.submit([path] { return hash_file(path); }));
+        }
+        for (size_t i = 0; i < to_hash.size(); i++) {
+            const auto& [entry, seen] = to_hash[i];
+            if (hashes[i].get() == entry->hash) verified[entry->path] = seen;
+            else report.damaged.push_back(entry->path);
+        }
+    }
+    if (verified != record) save_record(component, verified);
+    return report;
+}
+
+// Records a freshly extracted component without rehashing it: the frames it
+// came from were already checksummed on the way out.
+void record_component(const std::string& component)
+{
+    std::filesystem::path store = runtime_dir();
+    IntegrityRecord record;
+    for (const PackEntry& entry : component_entries(component)) {
+        if ((entry.mode & TYPE_MASK) == TYPE_DIRECTORY || (entry.mode & TYPE_MASK) == TYPE_SYMLINK) continue;
+        std::error_code ec;
+        std::filesystem::path path = store / entry.path;
+        int64_t mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        if (ec) continue;
+        record[entry.path] = {entry.hash, entry.size, mtime};
+    }
+    if (!record.empty()) save_record(component, record);
+}
+
+int run_doctor_command(bool repair, bool rehash)
+{
+    const SeekableArchive* pack = embedded_pack();
+    if (!pack || pack->entries().empty()) {
+        std::cerr << "The embedded runtime archive has no entry manifest to verify against." << endl;
+        return 1;
+    }
+    cout << "Runtime store: " << runtime_dir().string() << endl;
+    int status = 0;
+    for (const PackComponent& packed : pack->components()) {
+        if (!std::filesystem::exists(runtime_path(packed.name))) {
+            cout << packed.name << ": not installed" << endl;
+            continue;
+        }
+        IntegrityReport report = verify_component(packed.name, rehash);
+        if (report.damaged.empty()) {
+            cout << packed.name << ": ok (" << report.checked << " entries)" << endl;
+            continue;
+        }
+        cout << packed.name << ": " << report.damaged.size() << " of " << report.checked << " entries missing or damaged" << endl;
+        for (const std::string& path : report.damaged) cout << "  " << path << endl;
+        if (!repair) {
+            status = 1;
+            continue;
+        }
+        if (repair_runtime_component(packed.name, report.damaged)) cout << packed.name << ": repaired" << endl;
+        else {
+            std::cerr << packed.name << ": repair failed" << endl;
+            status = 1;
+        }
+    }
+    if (status != 0 && !repair) cout << "Run `myjvm doctor --repair` to re-extract the damaged entries." << endl;
+    return status;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Verification of installed runtime components against the entry manifest
+// carried by the embedded pack. Each component keeps a record next to it in
+// the store (<component>.integrity) of the size and mtime every file had
+// when it last matched its hash, so a routine check costs one stat per file
+// and only files whose stat changed are rehashed.
+
+struct IntegrityReport
+{
+    size_t checked = 0;
+    std::vector<std::string> damaged;  // store-relative paths that are missing or wrong
+};
+
+IntegrityReport verify_component(const std::string& component, bool rehash);
+void record_component(const std::string& component);
+int run_doctor_command(bool repair, bool rehash);
@@ -0,0 +1,566 @@
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <zlib.h>
+#include "jar.hpp"
+#include "manifest.hpp"
+#include "os.hpp"
+#include "thread_pool.hpp"
+
+using std::endl;
+
+static const uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static const uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static const uint32_t END_SIGNATURE = 0x06054b50;
+static const uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+static const uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+static const size_t LOCAL_HEADER_SIZE = 30;
+static const size_t CENTRAL_HEADER_SIZE = 46;
+static const size_t END_SIZE = 22;
+static const size_t ZIP64_LOCATOR_SIZE = 20;
+static const uint16_t METHOD_STORED = 0;
+static const uint16_t METHOD_DEFLATED = 8;
+static const uint16_t FLAG_UTF8 = 0x0800;
+static const uint16_t HASH_EXTRA_ID = 0x6d6a;  // central directory extra field holding an entry's content hash
+static const uint16_t VERSION_NEEDED = 20;
+static const uint16_t VERSION_MADE_BY = (3 << 8) | 20;  // Unix, ZIP 2.0
+static const uint16_t DOS_DATE = (0 << 9) | (1 << 5) | 1;  // 1980-01-01; fixed so jars are reproducible
+static const uint32_t EXTERNAL_ATTRIBUTES = 0100644u << 16;
+static const std::string MANIFEST_NAME = "META-INF/MANIFEST.MF";
+static const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+// A central directory record.
+struct JarEntry
+{
+    std::string name;
+    uint32_t crc;
+    uint64_t compressed_size;
+    uint64_t size;
+    uint64_t offset;  // of the local header
+    uint16_t method;
+    std::optional<uint64_t> hash;  // XXH3 of the uncompressed contents, for entries compressed here
+};
+
+struct JarDirectory
+{
+    std::vector<JarEntry> entries;
+};
+
+// The jar being replaced, mapped, so unchanged entries can be copied out of
+// it without compressing them again.
+struct PreviousJar
+{
+    const uint8_t* data;
+    size_t size;
+    JarDirectory directory;
+};
+
+struct EncodedEntry
+{
+    JarEntry entry;
+    std::vector<char> data;
+    const uint8_t* raw = nullptr;  // compressed bytes inside a mapped jar, used in place of data
+    bool reused = false;  // identical to the previous jar's entry
+};
+
+// One entry to produce: a file on disk, the manifest built in memory, or an
+// entry of another jar copied across still compressed.
+struct JarSource
+{
+    std::string name;
+    std::filesystem::path path;
+    std::string contents;
+    const JarEntry* raw_entry = nullptr;
+    const uint8_t* raw = nullptr;
+};
+
+// The mapped jars whose entries a write copies raw; they must outlive it.
+struct JarLayers
+{
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<std::unique_ptr<JarDirectory>> directories;
+};
+
+static void put16(std::string& out, uint16_t value)
+{
+    out += static_cast<char>(value & 0xFF);
+    out += static_cast<char>(value >> 8);
+}
+
+static void put32(std::string& out, uint32_t value)
+{
+    put16(out, value & 0xFFFF);
+    put16(out, value >> 16);
+}
+
+static void put64(std::string& out, uint64_t value)
+{
+    put32(out, value & 0xFFFFFFFF);
+    put32(out, value >> 32);
+}
+
+static uint16_t get16(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+    return get16(p) | (static_cast<uint32_t>(get16(p + 2)) << 16);
+}
+
+static uint64_t get64(const uint8_t* p)
+{
+    return get32(p) | (static_cast<uint64_t>(get32(p + 4)) << 32);
+}
+
+std::string jar_manifest(const std::string& main_class)
+{
+    std::string manifest = "Manifest-Version: 1.0\r\nCreated-By: myjvm\r\n";
+    if (!main_class.empty()) manifest += "Main-Class: " + main_class + "\r\n";
+    return manifest + "\r\n";
+}
+
+// Parses the central directory of a jar held in memory; nullopt if there is
+// none or it is not one we can copy entries from.
+static std::optional<JarDirectory> parse_directory(const uint8_t* data, size_t size)
+{
+    if (size < END_SIZE) return std::nullopt;
+    size_t search_end = size > END_SIZE + 0xFFFF ? size - END_SIZE - 0xFFFF : 0;
+    size_t end = size - END_SIZE;
+    while (get32(data + end) != END_SIGNATURE) {
+        if (end == search_end) return std::nullopt;
+        end--;
+    }
+    uint64_t count = get16(data + end + 10);
+    uint64_t directory_size = get32(data + end + 12);
+    uint64_t directory_offset = get32(data + end + 16);
+    if (end >= ZIP64_LOCATOR_SIZE && get32(data + end - ZIP64_LOCATOR_SIZE) == ZIP64_LOCATOR_SIGNATURE) {
+        uint64_t zip64_end = get64(data + end - ZIP64_LOCATOR_SIZE + 8);
+        if (zip64_end + 56 > size || get32(data + zip64_end) != ZIP64_END_SIGNATURE) return std::nullopt;
+        count = get64(data + zip64_end + 32);
+        directory_size = get64(data + zip64_end + 40);
+        directory_offset = get64(data + zip64_end + 48);
+    }
+    if (directory_offset + directory_size > size) return std::nullopt;
+    JarDirectory directory;
+    size_t pos = directory_offset;
+    for (uint64_t i = 0; i < count; i++) {
+        if (pos + CENTRAL_HEADER_SIZE > size || get32(data + pos) != CENTRAL_HEADER_SIGNATURE) return std::nullopt;
+        JarEntry entry;
+        entry.method = get16(data + pos + 10);
+        entry.crc = get32(data + pos + 16);
+        entry.compressed_size = get32(data + pos + 20);
+        entry.size = get32(data + pos + 24);
+        uint16_t name_size = get16(data + pos + 28);
+        uint16_t extra_size = get16(data + pos + 30);
+        uint16_t comment_size = get16(data + pos + 32);
+        entry.offset = get32(data + pos + 42);
+        if (pos + CENTRAL_HEADER_SIZE + name_size + extra_size > size) return std::nullopt;
+        entry.name.assign(reinterpret_cast<const char*>(data + pos + CENTRAL_HEADER_SIZE), name_size);
+        const uint8_t* extra = data + pos + CENTRAL_HEADER_SIZE + name_size;
+        for (size_t at = 0; at + 4 <= extra_size;) {
+            uint16_t id = get16(extra + at);
+            uint16_t length = get16(extra + at + 2);
+            if (at + 4 + length > extra_size) break;
+            if (id == HASH_EXTRA_ID && length == 8) entry.hash = get64(extra + at + 4);
+            at += 4 + length;
+        }
+        // We never write ZIP64 entries; a jar that has them gets rewritten.
+        if (entry.compressed_size == 0xFFFFFFFF || entry.size == 0xFFFFFFFF || entry.offset == 0xFFFFFFFF) return std::nullopt;
+        if (entry.offset + LOCAL_HEADER_SIZE + name_size + entry.compressed_size > directory_offset) return std::nullopt;
+        directory.entries.push_back(std::move(entry));
+        pos += CENTRAL_HEADER_SIZE + name_size + extra_size + comment_size;
+    }
+    return directory;
+}
+
+// The compressed bytes of `entry` inside a mapped jar; nullptr if its local
+// header is not one we wrote or it runs past the end.
+static const uint8_t* entry_bytes(const uint8_t* data, size_t size, const JarEntry& entry)
+{
+    if (entry.offset + LOCAL_HEADER_SIZE > size) return nullptr;
+    const uint8_t* header = data + entry.offset;
+    if (get32(header) != LOCAL_HEADER_SIGNATURE || (get16(header + 6) & 0x0001)) return nullptr;
+    uint64_t start = entry.offset + LOCAL_HEADER_SIZE + get16(header + 26) + get16(header + 28);
+    if (start + entry.compressed_size > size) return nullptr;
+    return data + start;
+}
+
+// Signature files would no longer match once entries are merged, and every
+// jar brings its own manifest.
+static bool is_layer_metadata(const std::string& name)
+{
+    if (name == MANIFEST_NAME) return true;
+    if (!name.starts_with("META-INF/") || name.find('/', 9) != std::string::npos) return false;
+    for (const char* ext : {".SF", ".RSA", ".DSA", ".EC"}) {
+        if (name.ends_with(ext)) return true;
+    }
+    return false;
+}
+
+// Queues every entry of `jar_path` not already in `seen` for a raw copy:
+// the compressed bytes move across untouched, with their CRC and sizes.
+static bool add_layer(const std::filesystem::path& jar_path, JarLayers& layers,
+                      std::unordered_set<std::string>& seen, std::vector<JarSource>& sources)
+{
+    auto file = std::make_unique<MappedFile>(jar_path);
+    std::optional<JarDirectory> directory;
+    if (file->ok()) directory = parse_directory(file->data(), file->size());
+    if (!directory) {
+        std::cerr << "Unable to read jar " << jar_path.string() << endl;
+        return false;
+    }
+    auto owned = std::make_unique<JarDirectory>(std::move(*directory));
+    const uint8_t* data = file->data();
+    for (const JarEntry& entry : owned->entries) {
+        if (is_layer_metadata(entry.name) || !seen.insert(entry.name).second) continue;
+        const uint8_t* header = data + entry.offset;
+        if (get32(header) != LOCAL_HEADER_SIGNATURE || (get16(header + 6) & 0x0001)) {
+            std::cerr << "Unsupported entry " << entry.name << " in " << jar_path.string() << endl;
+            return false;
+        }
+        if (entry.method != METHOD_STORED && entry.method != METHOD_DEFLATED) {
+            std::cerr << "Unsupported compression for " << entry.name << " in " << jar_path.string() << endl;
+            return false;
+        }
+        uint64_t start = entry.offset + LOCAL_HEADER_SIZE + get16(header + 26) + get16(header + 28);
+        if (start + entry.compressed_size > file->size()) {
+            std::cerr << "Truncated entry " << entry.name << " in " << jar_path.string() << endl;
+            return false;
+        }
+        sources.push_back({entry.name, "", "", &entry, data + start});
+    }
+    layers.files.push_back(std::move(file));
+    layers.directories.push_back(std::move(owned));
+    return true;
+}
+
+// Raw deflate with a per-thread stream, reset between entries.
+static std::vector<char> deflate_bytes(const uint8_t* data, size_t size, int level)
+{
+    struct Deflater
+    {
+        z_stream stream = {};
+        int level = -2;
+        ~Deflater() { if (level != -2) deflateEnd(&stream); }
+    };
+    thread_local Deflater deflater;
+    if (deflater.level != level) {
+        if (deflater.level != -2) deflateEnd(&deflater.stream);
+        deflater.stream = {};
+        if (deflateInit2(&deflater.stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            deflater.level = -2;
+            throw std::runtime_error("Unable to initialise deflate");
+        }
+        deflater.level = level;
+    }
+    else deflateReset(&deflater.stream);
+    std::vector<char> output(deflateBound(&deflater.stream, size));
+    deflater.stream.next_in = const_cast<Bytef*>(data);
+    deflater.stream.avail_in = size;
+    deflater.stream.next_out = reinterpret_cast<Bytef*>(output.data());
+    deflater.stream.avail_out = output.size();
+    if (deflate(&deflater.stream, Z_FINISH) != Z_STREAM_END) throw std::runtime_error("Deflate failed");
+    output.resize(deflater.stream.total_out);
+    return output;
+}
+
+// `previous` is the same entry in the jar being replaced, `previous_bytes`
+// its compressed bytes there; they are reused when the contents hash the same.
+static EncodedEntry encode_entry(const std::string& name, const uint8_t* data, size_t size,
+                                 const JarEntry* previous, const uint8_t* previous_bytes, int level)
+{
+    EncodedEntry encoded;
+    uint64_t hash = hash_bytes(data, size);
+    if (previous && previous_bytes && previous->hash == hash && previous->size == size) {
+        encoded.entry = *previous;
+        encoded.raw = previous_bytes;
+        encoded.reused = true;
+        return encoded;
+    }
+    encoded.entry = {name, static_cast<uint32_t>(crc32_z(0, data, size)), 0, size, 0, METHOD_DEFLATED, hash};
+    encoded.data = deflate_bytes(data, size, level);
+    if (encoded.data.size() >= size) {
+        // Incompressible: store it instead.
+        encoded.entry.method = METHOD_STORED;
+        encoded.data.assign(data, data + size);
+    }
+    encoded.entry.compressed_size = encoded.data.size();
+    return encoded;
+}
+
+// Buffers small writes into large ones at an explicit offset.
+class JarSink
+{
+private:
+    // Fields
+    std::fstream& m_file;
+    uint64_t m_pos;
+    std::string m_pending;
+public:
+    JarSink(std::fstream& file, uint64_t pos) : m_file(file), m_pos(pos)
+    {
+        m_file.seekp(pos);
+    }
+    inline uint64_t pos() const { return m_pos + m_pending.size(); }
+    inline void write(const std::string& bytes) { write(bytes.data(), bytes.size()); }
+    void write(const char* data, size_t size)
+    {
+        m_pending.append(data, size);
+        if (m_pending.size() >= WRITE_BUFFER_SIZE) flush();
+    }
+    void flush()
+    {
+        m_file.write(m_pending.data(), m_pending.size());
+        m_pos += m_pending.size();
+        m_pending.clear();
+    }
+};
+
+static void write_local_entry(JarSink& sink, const EncodedEntry& encoded)
+{
+    const JarEntry& entry = encoded.entry;
+    std::string header;
+    put32(header, LOCAL_HEADER_SIGNATURE);
+    put16(header, VERSION_NEEDED);
+    put16(header, FLAG_UTF8);
+    put16(header, entry.method);
+    put16(header, 0);  // time
+    put16(header, DOS_DATE);
+    put32(header, entry.crc);
+    put32(header, entry.compressed_size);
+    put32(header, entry.size);
+    put16(header, entry.name.size());
+    put16(header, 0);  // extra
+    header += entry.name;
+    sink.write(header);
+    if (encoded.raw) sink.write(reinterpret_cast<const char*>(encoded.raw), entry.compressed_size);
+    else sink.write(encoded.data.data(), encoded.data.size());
+}
+
+static void write_directory(JarSink& sink, const std::vector<JarEntry>& entries)
+{
+    uint64_t directory_offset = sink.pos();
+    std::string out;
+    for (const JarEntry& entry : entries) {
+        put32(out, CENTRAL_HEADER_SIGNATURE);
+        put16(out, VERSION_MADE_BY);
+        put16(out, VERSION_NEEDED);
+        put16(out, FLAG_UTF8);
+        put16(out, entry.method);
+        put16(out, 0);  // time
+        put16(out, DOS_DATE);
+        put32(out, entry.crc);
+        put32(out, entry.compressed_size);
+        put32(out, entry.size);
+        put16(out, entry.name.size());
+        put16(out, entry.hash ? 12 : 0);  // extra
+        put16(out, 0);  // comment
+        put16(out, 0);  // disk
+        put16(out, 0);  // internal attributes
+        put32(out, EXTERNAL_ATTRIBUTES);
+        put32(out, entry.offset);
+        out += entry.name;
+        if (entry.hash) {
+            put16(out, HASH_EXTRA_ID);
+            put16(out, 8);
+            put64(out, *entry.hash);
+        }
+    }
+    uint64_t directory_size = out.size();
+    uint64_t count = entries.size();
+    bool zip64 = count >= 0xFFFF || directory_offset >= 0xFFFFFFFF || directory_size >= 0xFFFFFFFF;
+    if (zip64) {
+        uint64_t zip64_end = directory_offset + directory_size;
+        put32(out, ZIP64_END_SIGNATURE);
+        put64(out, 44);  // size of the rest of this record
+        put16(out, 45);
+        put16(out, 45);
+        put32(out, 0);
+        put32(out, 0);
+        put64(out, count);
+        put64(out, count);
+        put64(out, directory_size);
+        put64(out, directory_offset);
+        put32(out, ZIP64_LOCATOR_SIGNATURE);
+        put32(out, 0);
+        put64(out, zip64_end);
+        put32(out, 1);
+    }
+    put32(out, END_SIGNATURE);
+    put16(out, 0);
+    put16(out, 0);
+    put16(out, zip64 ? 0xFFFF : count);
+    put16(out, zip64 ? 0xFFFF : count);
+    put32(out, zip64 ? 0xFFFFFFFF : directory_size);
+    put32(out, zip64 ? 0xFFFFFFFF : directory_offset);
+    put16(out, 0);  // comment
+    sink.write(out);
+    sink.flush();
+}
+
+// The manifest, then the inputs by name, then whatever the layer adds that
+// the inputs do not replace.
+static std::optional<std::vector<JarSource>> jar_sources(const std::vector<JarInput>& inputs, const JarOptions& options,
+                                                         JarLayers& layers)
+{
+    std::vector<JarSource> sources;
+    sources.push_back({MANIFEST_NAME, "", jar_manifest(options.main_class)});
+    std::vector<JarInput> sorted = inputs;
+    std::sort(sorted.begin(), sorted.end(), [](const JarInput& a, const JarInput& b) { return a.name < b.name; });
+    std::unordered_set<std::string> seen = {MANIFEST_NAME};
+    for (const JarInput& input : sorted) {
+        if (!seen.insert(input.name).second) continue;
+        sources.push_back({input.name, input.path, ""});
+    }
+    if (!options.layer.empty() && !add_layer(options.layer, layers, seen, sources)) return std::nullopt;
+    return sources;
+}
+
+// Encodes `sources` on a pool and writes them in source order. Entries that
+// match `previous` are copied from it still compressed. Nothing is written
+// while every entry so far is the previous jar's, in its order; nullopt if
+// that holds to the end, since the jar would come out the same.
+static std::optional<std::vector<JarEntry>> emit_entries(JarSink& sink, const std::vector<JarSource>& sources,
+                                                         const PreviousJar* previous, int level, JarStats& stats)
+{
+    std::unordered_map<std::string, const JarEntry*> existing;
+    if (previous) {
+        for (const JarEntry& entry : previous->directory.entries) existing[entry.name] = &entry;
+    }
+    ThreadPool pool;
+    std::deque<std::future<EncodedEntry>> inflight;
+    std::vector<JarEntry> directory;
+    std::vector<EncodedEntry> held;
+    bool diverged = !previous;
+    auto write_entry = [&](EncodedEntry& encoded) {
+        encoded.entry.offset = sink.pos();
+        if (encoded.entry.offset >= 0xFFFFFFFF) throw std::runtime_error("Jar exceeds 4 GB");
+        write_local_entry(sink, encoded);
+        directory.push_back(encoded.entry);
+    };
+    auto drain_one = [&] {
+        EncodedEntry encoded = inflight.front().get();
+        inflight.pop_front();
+        if (encoded.reused) stats.reused++;
+        else stats.written++;
+        if (!diverged) {
+            size_t index = held.size();
+            const std::vector<JarEntry>& old_entries = previous->directory.entries;
+            if (encoded.reused && index < old_entries.size() && old_entries[index].name == encoded.entry.name) {
+                held.push_back(std::move(encoded));
+                return;
+            }
+            diverged = true;
+            for (EncodedEntry& earlier : held) write_entry(earlier);
+            held.clear();
+        }
+        write_entry(encoded);
+    };
+    for (const JarSource& source : sources) {
+        auto it = existing.find(source.name);
+        const JarEntry* prior = it == existing.end() ? nullptr : it->second;
+        const uint8_t* prior_bytes = prior ? entry_bytes(previous->data, previous->size, *prior) : nullptr;
+        inflight.push_back(pool.submit([&source, prior, prior_bytes, level] {
+            if (source.raw) {
+                EncodedEntry copied;
+                copied.entry = *source.raw_entry;
+                copied.entry.hash.reset();
+                copied.raw = source.raw;
+                // Raw bytes are compared as they are, so a match is exact.
+                copied.reused = prior && prior_bytes && !prior->hash && prior->method == copied.entry.method
+                    && prior->crc == copied.entry.crc && prior->size == copied.entry.size
+                    && prior->compressed_size == copied.entry.compressed_size
+                    && std::equal(source.raw, source.raw + copied.entry.compressed_size, prior_bytes);
+                return copied;
+            }
+            if (source.path.empty()) {
+                return encode_entry(source.name, reinterpret_cast<const uint8_t*>(source.contents.data()),
+                                    source.contents.size(), prior, prior_bytes, level);
+            }
+            MappedFile file(source.path);
+            if (!file.ok()) throw std::runtime_error("Failed to read " + source.path.string());
+            return encode_entry(source.name, file.data(), file.size(), prior, prior_bytes, level);
+        }));
+        if (inflight.size() >= pool.size() * 4) drain_one();
+    }
+    while (!inflight.empty()) drain_one();
+    if (!diverged && held.size() == previous->directory.entries.size()) return std::nullopt;
+    for (EncodedEntry& earlier : held) write_entry(earlier);
+    return directory;
+}
+
+// Writes `sources` to a fresh file and moves it over `jar_path`, so a JVM
+// still running from the old jar keeps reading the old file. Left alone if
+// it would come out the same as `previous`.
+static bool write_sources(const std::filesystem::path& jar_path, const std::vector<JarSource>& sources,
+                          const PreviousJar* previous, int level, JarStats* stats)
+{
+    std::filesystem::path temp_path = jar_path;
+    temp_path += ".tmp-" + std::to_string(getpid());
+    JarStats local_stats;
+    bool unchanged = false;
+    try {
+        std::fstream file(temp_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Failed to open " << temp_path << endl;
+            return false;
+        }
+        JarSink sink(file, 0);
+        std::optional<std::vector<JarEntry>> directory = emit_entries(sink, sources, previous, level, local_stats);
+        if (directory) write_directory(sink, *directory);
+        else unchanged = true;
+        if (!file) throw std::runtime_error("Write failed");
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << "Unable to write " << jar_path.string() << ": " << e.what() << endl;
+        std::filesystem::remove(temp_path);
+        return false;
+    }
+    if (unchanged) std::filesystem::remove(temp_path);
+    else std::filesystem::rename(temp_path, jar_path);
+    if (stats) *stats = local_stats;
+    return true;
+}
+
+bool write_jar(const std::filesystem::path& jar_path, const std::vector<JarInput>& inputs,
+               const JarOptions& options, JarStats* stats)
+{
+    JarLayers layers;
+    std::optional<std::vector<JarSource>> sources = jar_sources(inputs, options, layers);
+    if (!sources) return false;
+    return write_sources(jar_path, *sources, nullptr, options.level, stats);
+}
+
+bool update_jar(const std::filesystem::path& jar_path, const std::vector<JarInput>& inputs,
+                const JarOptions& options, JarStats* stats)
+{
+    MappedFile file(jar_path);
+    std::optional<JarDirectory> directory;
+    if (file.ok()) directory = parse_directory(file.data(), file.size());
+    if (!directory) return write_jar(jar_path, inputs, options, stats);
+    JarLayers layers;
+    std::optional<std::vector<JarSource>> sources = jar_sources(inputs, options, layers);
+    if (!sources) return false;
+    PreviousJar previous = {file.data(), file.size(), std::move(*directory)};
+    return write_sources(jar_path, *sources, &previous, options.level, stats);
+}
+
+bool merge_jars(const std::filesystem::path& output, const std::vector<std::filesystem::path>& jars)
+{
+    JarLayers layers;
+    std::unordered_set<std::string> seen;
+    std::vector<JarSource> sources;
+    for (const std::filesystem::path& jar : jars) {
+        if (!add_layer(jar, layers, seen, sources)) return false;
+    }
+    return write_sources(output, sources, nullptr, 6, nullptr);
+}
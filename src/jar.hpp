@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// JAR writer for out/all_files.jar. Inputs are memory-mapped and deflated on
+// a thread pool. Each entry's content hash is kept in the central directory,
+// so updating an existing jar copies the compressed bytes of unchanged
+// entries across and only deflates new or changed ones. The new jar is
+// written beside the old one and renamed over it. Entries can also be
+// copied from a prebuilt jar still compressed, without inflating them.
+
+struct JarInput
+{
+    std::string name;  // path inside the jar, '/'-separated
+    std::filesystem::path path;
+};
+
+struct JarOptions
+{
+    std::string main_class;
+    std::filesystem::path layer;  // jar whose entries are copied in raw, after the inputs
+    int level = 6;
+};
+
+struct JarStats
+{
+    size_t written = 0;  // entries compressed or copied and written
+    size_t reused = 0;   // entries copied from the previous jar
+};
+
+bool write_jar(const std::filesystem::path& jar_path, const std::vector<JarInput>& inputs,
+               const JarOptions& options, JarStats* stats = nullptr);
+bool update_jar(const std::filesystem::path& jar_path, const std::vector<JarInput>& inputs,
+                const JarOptions& options, JarStats* stats = nullptr);
+// Copies every entry of `jars` into one jar without recompressing; the first
+// jar to have a name wins. Manifests and signature files are left out.
+bool merge_jars(const std::filesystem::path& output, const std::vector<std::filesystem::path>& jars);
+std::string jar_manifest(const std::string& main_class);
@@ -0,0 +1,373 @@
+#include <archive.h>
+#include <archive_entry.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <xxhash.h>
+#include <zstd.h>
+#include "langpack.hpp"
+
+using std::endl;
+
+static const uint32_t SKIPPABLE_SEEK_TABLE_MAGIC = 0x184D2A5E;
+static const uint32_t SKIPPABLE_INDEX_MAGIC = 0x184D2A5C;
+static const uint32_t SKIPPABLE_ENTRIES_MAGIC = 0x184D2A5D;
+static const uint32_t COMPONENT_INDEX_MAGIC = 0x49434A4D; // "MJCI"
+static const uint32_t ENTRY_MANIFEST_MAGIC = 0x4D454A4D; // "MJEM"
+static const uint32_t SEEKABLE_MAGIC = 0x8F92EAB1;
+static const size_t SEEK_TABLE_FOOTER_SIZE = 9;
+static const size_t SKIPPABLE_HEADER_SIZE = 8;
+static const uint8_t CHECKSUM_FLAG = 0x80;
+
+static uint32_t read_le32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t read_le64(const uint8_t* p)
+{
+    return read_le32(p) | (static_cast<uint64_t>(read_le32(p + 4)) << 32);
+}
+
+static void append_le32(std::string& out, uint32_t value)
+{
+    out += static_cast<char>(value & 0xFF);
+    out += static_cast<char>((value >> 8) & 0xFF);
+    out += static_cast<char>((value >> 16) & 0xFF);
+    out += static_cast<char>((value >> 24) & 0xFF);
+}
+
+static void append_le64(std::string& out, uint64_t value)
+{
+    append_le32(out, value & 0xFFFFFFFF);
+    append_le32(out, value >> 32);
+}
+
+static void write_le32(std::ostream& out, uint32_t value)
+{
+    std::string bytes;
+    append_le32(bytes, value);
+    out.write(bytes.data(), bytes.size());
+}
+
+// Layout: "MJCI", count, then per component a u32 name length, the name,
+// its first frame and its frame count.
+static std::optional<std::vector<PackComponent>> parse_component_index(const uint8_t* data, size_t size)
+{
+    if (size < 8 || read_le32(data) != COMPONENT_INDEX_MAGIC) return std::nullopt;
+    uint32_t count = read_le32(data + 4);
+    size_t pos = 8;
+    std::vector<PackComponent> components;
+    for (uint32_t i = 0; i < count; i++) {
+        if (pos + 4 > size) return std::nullopt;
+        uint32_t name_size = read_le32(data + pos);
+        pos += 4;
+        if (pos + name_size + 8 > size) return std::nullopt;
+        PackComponent component;
+        component.name.assign(reinterpret_cast<const char*>(data + pos), name_size);
+        pos += name_size;
+        component.first_frame = read_le32(data + pos);
+        component.frame_count = read_le32(data + pos + 4);
+        pos += 8;
+        components.push_back(std::move(component));
+    }
+    return components;
+}
+
+// Layout: "MJEM", count, then per entry a u32 path length, the path, its
+// mode, and its size and hash as u64s.
+static std::optional<std::vector<PackEntry>> parse_entry_manifest(const uint8_t* data, size_t size)
+{
+    if (size < 8 || read_le32(data) != ENTRY_MANIFEST_MAGIC) return std::nullopt;
+    uint32_t count = read_le32(data + 4);
+    size_t pos = 8;
+    std::vector<PackEntry> entries;
+    for (uint32_t i = 0; i < count; i++) {
+        if (pos + 4 > size) return std::nullopt;
+        uint32_t path_size = read_le32(data + pos);
+        pos += 4;
+        if (pos + path_size + 20 > size) return std::nullopt;
+        PackEntry entry;
+        entry.path.assign(reinterpret_cast<const char*>(data + pos), path_size);
+        pos += path_size;
+        entry.mode = read_le32(data + pos);
+        entry.size = read_le64(data + pos + 4);
+        entry.hash = read_le64(data + pos + 12);
+        pos += 20;
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+static uint32_t frame_checksum(const void* data, size_t size)
+{
+    return static_cast<uint32_t>(XXH64(data, size, 0));
+}
+
+std::optional<SeekableArchive> SeekableArchive::open(const uint8_t* data, size_t size)
+{
+    if (size < SEEK_TABLE_FOOTER_SIZE + SKIPPABLE_HEADER_SIZE) return std::nullopt;
+    const uint8_t* footer = data + size - SEEK_TABLE_FOOTER_SIZE;
+    if (read_le32(footer + 5) != SEEKABLE_MAGIC) return std::nullopt;
+    uint32_t frame_count = read_le32(footer);
+    bool checksums = footer[4] & CHECKSUM_FLAG;
+    size_t entry_size = checksums ? 12 : 8;
+    size_t table_size = SKIPPABLE_HEADER_SIZE + static_cast<size_t>(frame_count) * entry_size + SEEK_TABLE_FOOTER_SIZE;
+    if (table_size > size) return std::nullopt;
+    const uint8_t* table = data + size - table_size;
+    if (read_le32(table) != SKIPPABLE_SEEK_TABLE_MAGIC) return std::nullopt;
+    SeekableArchive archive;
+    archive.m_data = data;
+    archive.m_size = size;
+    archive.m_checksums = checksums;
+    // The component index and entry manifest, when present, are skippable
+    // frames ahead of the first data frame.
+    uint64_t offset = 0;
+    while (offset + SKIPPABLE_HEADER_SIZE <= size - table_size) {
+        uint32_t magic = read_le32(data + offset);
+        if (magic != SKIPPABLE_INDEX_MAGIC && magic != SKIPPABLE_ENTRIES_MAGIC) break;
+        uint32_t frame_size = read_le32(data + offset + 4);
+        if (offset + SKIPPABLE_HEADER_SIZE + frame_size > size - table_size) return std::nullopt;
+        const uint8_t* payload = data + offset + SKIPPABLE_HEADER_SIZE;
+        if (magic == SKIPPABLE_INDEX_MAGIC) {
+            std::optional<std::vector<PackComponent>> components = parse_component_index(payload, frame_size);
+            if (!components) return std::nullopt;
+            archive.m_components = std::move(*components);
+        }
+        else {
+            std::optional<std::vector<PackEntry>> entries = parse_entry_manifest(payload, frame_size);
+            if (!entries) return std::nullopt;
+            archive.m_entries = std::move(*entries);
+        }
+        offset += SKIPPABLE_HEADER_SIZE + frame_size;
+    }
+    size_t index_end = offset;
+    const uint8_t* entry = table + SKIPPABLE_HEADER_SIZE;
+    for (uint32_t i = 0; i < frame_count; i++, entry += entry_size) {
+        SeekFrame frame = {offset, read_le32(entry), read_le32(entry + 4), checksums ? read_le32(entry + 8) : 0};
+        offset += frame.compressed_size;
+        archive.m_frames.push_back(frame);
+    }
+    if (offset != size - table_size) return std::nullopt;
+    for (const PackComponent& component : archive.m_components) {
+        if (static_cast<uint64_t>(component.first_frame) + component.frame_count > frame_count) return std::nullopt;
+    }
+    XXH3_state_t* state = XXH3_createState();
+    XXH3_64bits_reset(state);
+    XXH3_64bits_update(state, data, index_end);
+    XXH3_64bits_update(state, table, table_size);
+    archive.m_fingerprint = XXH3_64bits_digest(state);
+    XXH3_freeState(state);
+    return archive;
+}
+
+const PackComponent* SeekableArchive::find_component(const std::string& name) const
+{
+    for (const PackComponent& component : m_components) {
+        if (component.name == name) return &component;
+    }
+    return nullptr;
+}
+
+std::vector<char> SeekableArchive::decompress_frame(size_t index) const
+{
+    thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    const SeekFrame& frame = m_frames.at(index);
+    std::vector<char> output(frame.decompressed_size);
+    size_t ret = ZSTD_decompressDCtx(dctx.get(), output.data(), output.size(), m_data + frame.offset, frame.compressed_size);
+    if (ZSTD_isError(ret)) {
+        throw std::runtime_error("Decompression error in frame " + std::to_string(index) + ": " + ZSTD_getErrorName(ret));
+    }
+    if (ret != frame.decompressed_size) {
+        throw std::runtime_error("Frame " + std::to_string(index) + " decompressed to an unexpected size.");
+    }
+    if (m_checksums && frame_checksum(output.data(), output.size()) != frame.checksum) {
+        throw std::runtime_error("Checksum mismatch in frame " + std::to_string(index) + ".");
+    }
+    return output;
+}
+
+ParallelFrameReader::ParallelFrameReader(const SeekableArchive& archive, ThreadPool& pool)
+    : m_archive(archive), m_pool(pool), m_next_frame(0), m_end_frame(archive.frames().size()), m_window(pool.size() * 2)
+{
+}
+
+ParallelFrameReader::ParallelFrameReader(const SeekableArchive& archive, ThreadPool& pool, const PackComponent& component)
+    : m_archive(archive), m_pool(pool), 
+      m_next_frame(component.first_frame), m_end_frame(component.first_frame + component.frame_count), 
+      m_window(pool.size() * 2)
+{
+}
+
+// Frames still in flight when extraction stops early (say, on a write
+// error) are waited for, so nothing outlives the reader's queue.
+ParallelFrameReader::~ParallelFrameReader()
+{
+    for (std::future<std::vector<char>>& frame : m_inflight) frame.wait();
+}
+
+bool ParallelFrameReader::next(const void** data, size_t* size)
+{
+    while (m_next_frame < m_end_frame && m_inflight.size() < m_window) {
+        size_t index = m_next_frame++;
+        const SeekableArchive& archive = m_archive;
+        m_inflight.push_back(m_pool.submit([&archive, index] { return archive.decompress_frame(index); }));
+    }
+    if (m_inflight.empty()) return false;
+    m_current = m_inflight.front().get();
+    m_inflight.pop_front();
+    *data = m_current.data();
+    *size = m_current.size();
+    return true;
+}
+
+struct CompressedFrame
+{
+    std::vector<char> data;
+    uint32_t decompressed_size;
+    uint32_t checksum;
+};
+
+static CompressedFrame compress_frame(std::vector<char> input, int level)
+{
+    thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+    CompressedFrame frame;
+    frame.data.resize(ZSTD_compressBound(input.size()));
+    size_t ret = ZSTD_compressCCtx(cctx.get(), frame.data.data(), frame.data.size(), input.data(), input.size(), level);
+    if (ZSTD_isError(ret)) throw std::runtime_error("Compression error: " + std::string(ZSTD_getErrorName(ret)));
+    frame.data.resize(ret);
+    frame.decompressed_size = input.size();
+    frame.checksum = frame_checksum(input.data(), input.size());
+    return frame;
+}
+
+// Lists a component tar's entries, hashing each body as it goes.
+static bool scan_tar_entries(const std::string& tar_path, std::vector<PackEntry>& entries)
+{
+    struct archive* a = archive_read_new();
+    archive_read_support_format_tar(a);
+    if (archive_read_open_filename(a, tar_path.c_str(), 1 << 16) != ARCHIVE_OK) {
+        std::cerr << "Unable to read " << tar_path << ": " << archive_error_string(a) << endl;
+        archive_read_free(a);
+        return false;
+    }
+    XXH3_state_t* state = XXH3_createState();
+    archive_entry* entry;
+    while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
+        PackEntry packed = {archive_entry_pathname(entry), static_cast<uint32_t>(archive_entry_mode(entry)), 0, 0};
+        auto type = archive_entry_filetype(entry);
+        if (type == AE_IFLNK) {
+            std::string target = archive_entry_symlink(entry);
+            packed.size = target.size();
+            packed.hash = XXH3_64bits(target.data(), target.size());
+        }
+        else if (type == AE_IFREG) {
+            XXH3_64bits_reset(state);
+            const void* buff;
+            size_t size;
+            la_int64_t offset;
+            while (archive_read_data_block(a, &buff, &size, &offset) == ARCHIVE_OK) {
+                XXH3_64bits_update(state, buff, size);
+                packed.size += size;
+            }
+            packed.hash = XXH3_64bits_digest(state);
+        }
+        else if (type != AE_IFDIR) continue;
+        entries.push_back(std::move(packed));
+    }
+    XXH3_freeState(state);
+    archive_read_free(a);
+    return true;
+}
+
+bool write_seekable_archive(const std::vector<PackInput>& inputs, const std::string& output_path, size_t frame_size, int level)
+{
+    // Frames never span components, so each one's frame count is known up
+    // front and the index can be written before any data.
+    std::string index;
+    append_le32(index, COMPONENT_INDEX_MAGIC);
+    append_le32(index, inputs.size());
+    uint32_t next_frame = 0;
+    for (const PackInput& input : inputs) {
+        std::error_code ec;
+        uintmax_t size = std::filesystem::file_size(input.tar_path, ec);
+        if (ec) {
+            std::cerr << "Unable to stat " << input.tar_path << endl;
+            return false;
+        }
+        uint32_t frame_count = (size + frame_size - 1) / frame_size;
+        append_le32(index, input.component.size());
+        index += input.component;
+        append_le32(index, next_frame);
+        append_le32(index, frame_count);
+        next_frame += frame_count;
+    }
+    std::vector<PackEntry> entries;
+    for (const PackInput& input : inputs) {
+        if (!scan_tar_entries(input.tar_path, entries)) return false;
+    }
+    std::string manifest;
+    append_le32(manifest, ENTRY_MANIFEST_MAGIC);
+    append_le32(manifest, entries.size());
+    for (const PackEntry& entry : entries) {
+        append_le32(manifest, entry.path.size());
+        manifest += entry.path;
+        append_le32(manifest, entry.mode);
+        append_le64(manifest, entry.size);
+        append_le64(manifest, entry.hash);
+    }
+    std::ofstream out(output_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Unable to open " << output_path << endl;
+        return false;
+    }
+    write_le32(out, SKIPPABLE_INDEX_MAGIC);
+    write_le32(out, index.size());
+    out.write(index.data(), index.size());
+    write_le32(out, SKIPPABLE_ENTRIES_MAGIC);
+    write_le32(out, manifest.size());
+    out.write(manifest.data(), manifest.size());
+    ThreadPool pool;
+    std::deque<std::future<CompressedFrame>> inflight;
+    std::vector<SeekFrame> frames;
+    auto drain_one = [&] {
+        CompressedFrame frame = inflight.front().get();
+        inflight.pop_front();
+        out.write(frame.data.data(), frame.data.size());
+        frames.push_back({0, static_cast<uint32_t>(frame.data.size()), frame.decompressed_size, frame.checksum});
+    };
+    for (const PackInput& input : inputs) {
+        std::ifstream in(input.tar_path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Unable to open " << input.tar_path << endl;
+            return false;
+        }
+        while (in) {
+            std::vector<char> chunk(frame_size);
+            in.read(chunk.data(), chunk.size());
+            chunk.resize(in.gcount());
+            if (chunk.empty()) break;
+            inflight.push_back(pool.submit([chunk = std::move(chunk), level]() mutable { return compress_frame(std::move(chunk), level); }));
+            if (inflight.size() >= pool.size() * 2) drain_one();
+        }
+    }
+    while (!inflight.empty()) drain_one();
+    if (frames.size() != next_frame) {
+        std::cerr << "Component tars changed while packing." << endl;
+        return false;
+    }
+    write_le32(out, SKIPPABLE_SEEK_TABLE_MAGIC);
+    write_le32(out, frames.size() * 12 + SEEK_TABLE_FOOTER_SIZE);
+    for (const SeekFrame& frame : frames) {
+        write_le32(out, frame.compressed_size);
+        write_le32(out, frame.decompressed_size);
+        write_le32(out, frame.checksum);
+    }
+    write_le32(out, frames.size());
+    out.put(static_cast<char>(CHECKSUM_FLAG));
+    write_le32(out, SEEKABLE_MAGIC);
+    return static_cast<bool>(out);
+}
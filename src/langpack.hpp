@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <optional>
+#include <string>
+#include <vector>
+#include "thread_pool.hpp"
+
+// Seekable runtime pack: the tar stream split into independently compressed
+// ZSTD frames, followed by a seek table in the ZSTD seekable format (a
+// skippable frame, so plain `unzstd` still decompresses the whole thing).
+// Independent frames let extraction inflate on every core.
+//
+// Each runtime component (a top-level directory of .languages) is packed as
+// its own tar stream in its own run of frames, and a leading skippable frame
+// indexes them by name so a single component can be unpacked on its own.
+// A second skippable frame lists every entry with its size and hash, which
+// is what installed runtimes are verified against.
+
+struct SeekFrame
+{
+    uint64_t offset;  // into the compressed pack
+    uint32_t compressed_size;
+    uint32_t decompressed_size;
+    uint32_t checksum;  // low 32 bits of XXH64 of the decompressed frame
+};
+
+struct PackComponent
+{
+    std::string name;
+    uint32_t first_frame;
+    uint32_t frame_count;
+};
+
+struct PackEntry
+{
+    std::string path;  // as named in the component tar
+    uint32_t mode;  // file type and permission bits
+    uint64_t size;
+    uint64_t hash;  // XXH3 of the body, or of the link target for symlinks
+};
+
+class SeekableArchive
+{
+private:
+    // Fields
+    const uint8_t* m_data;
+    size_t m_size;
+    std::vector<SeekFrame> m_frames;
+    std::vector<PackComponent> m_components;
+    std::vector<PackEntry> m_entries;
+    bool m_checksums;
+    uint64_t m_fingerprint;
+public:
+    static std::optional<SeekableArchive> open(const uint8_t* data, size_t size);
+    std::vector<char> decompress_frame(size_t index) const;
+    const PackComponent* find_component(const std::string& name) const;
+    inline const std::vector<SeekFrame>& frames() const { return m_frames; }
+    inline const std::vector<PackComponent>& components() const { return m_components; }
+    inline const std::vector<PackEntry>& entries() const { return m_entries; }
+    // Hash of the leading index frames and the seek table. The table carries a
+    // checksum of every frame, so this identifies the pack's contents.
+    inline uint64_t fingerprint() const { return m_fingerprint; }
+};
+
+// Hands out decompressed frames in order while keeping a window of later
+// frames inflating on the pool.
+class ParallelFrameReader
+{
+private:
+    // Fields
+    const SeekableArchive& m_archive;
+    ThreadPool& m_pool;
+    std::deque<std::future<std::vector<char>>> m_inflight;
+    std::vector<char> m_current;
+    size_t m_next_frame;
+    size_t m_end_frame;
+    size_t m_window;
+public:
+    ParallelFrameReader(const SeekableArchive& archive, ThreadPool& pool);
+    ParallelFrameReader(const SeekableArchive& archive, ThreadPool& pool, const PackComponent& component);
+    ParallelFrameReader(const ParallelFrameReader&) = delete;
+    ParallelFrameReader& operator=(const ParallelFrameReader&) = delete;
+    ~ParallelFrameReader();
+    bool next(const void** data, size_t* size);
+};
+
+struct PackInput
+{
+    std::string component;
+    std::string tar_path;
+};
+
+bool write_seekable_archive(const std::vector<PackInput>& inputs, const std::string& output_path, size_t frame_size, int level);
@@ -1,35 +1,74 @@
 #include <cstdlib>
+#include "batch.hpp"
+#include "daemon.hpp"
+#include "integrity.hpp"
+#include "prewarm.hpp"
+#include "runtime.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
+#include "watch.hpp"
 
 using std::cout; 
 using std::endl;
 
-int main(int argc, char** argv) 
+static int run(int argc, char** argv)
 {
-    if (!std::filesystem::exists(".languages")) {
-        cout << "Generating JVM runtimes..." << endl;
-        restore_languages_directory();
-        cout << "Runtimes generated successfully!" << endl;
+    TraceScope trace("myjvm");
+    if (argc > 1 && std::string(argv[1]) == "daemon") {
+        std::string action = argc > 2 ? argv[2] : "start";
+        if (action == "start") ensure_runtime({"jvm-runtime-standard", "scala-compiler-jars", "kotlin-compiler"});
+        return run_daemon_command(action);
+    }
+    if (argc > 1 && std::string(argv[1]) == "doctor") {
+        bool repair = false;
+        bool rehash = false;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--repair") repair = true;
+            else if (arg == "--rehash") rehash = true;
+            else {
+                std::cerr << "Usage: myjvm doctor [--repair] [--rehash]" << endl;
+                return 1;
+            }
+        }
+        return run_doctor_command(repair, rehash);
+    }
+    if (argc > 1 && std::string(argv[1]) == "prewarm") return run_prewarm_command();
+    if (argc > 1 && std::string(argv[1]) == "batch") {
+        // `batch --job` is how the batch starts each project.
+        if (argc > 2 && std::string(argv[2]) == "--job") return run_batch_job(argc > 3 ? argv[3] : "");
+        return run_batch_command(argv[0], std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if (argc > 1 && std::string(argv[1]) == "watch") {
+        if (argc < 3) {
+            std::cerr << "Usage: myjvm watch <project_path> [main_class]" << endl;
+            return 1;
+        }
+        return run_watch_command(argv[2], argc > 3 ? argv[3] : "");
     }
     std::vector<std::string> files; 
     if (argc > 1) files = find_source_files(argv[1]); 
     else {
         std::cerr << "Usage: myjvm <project_path> [main_class]" << endl;
-        exit(1);
-    }
-    std::string filetype = infer_file_type(".");
-    bool recompile = any_env_prefix_set("RECOMPILE");
-    if (!already_compiled(".") || recompile) {
-        compile_files(files, filetype);
+        std::cerr << "       myjvm daemon [start|stop|status]" << endl;
+        std::cerr << "       myjvm doctor [--repair] [--rehash]" << endl;
+        std::cerr << "       myjvm prewarm" << endl;
+        std::cerr << "       myjvm batch <manifest> [--jobs N] [--timeout SECONDS] [--report FILE]" << endl;
+        std::cerr << "       myjvm watch <project_path> [main_class]" << endl;
+        return 1;
     }
-    std::vector<std::string> class_names = get_class_names();
-    std::string result;
-    if (argc > 2) {
-      std::string arg = std::string(argv[2]);
-      result = run_known_class_file(arg, filetype); 
-    }
-    else result = try_run_class_files(class_names, filetype);
-    cout << result << endl;
+    std::string filetype = infer_file_type(argv[1]);
+    std::vector<std::string> components = runtime_components(filetype);
+    ensure_runtime(components);
+    prewarm_components(components);
+    if (!build_project(files, filetype)) return 1;
+    if (argc > 2) return run_known_class_file(argv[2], filetype);
+    return run_detected_entry_point(filetype);
+}
 
-    return 0;
+int main(int argc, char** argv) 
+{
+    int status = run(argc, argv);
+    trace_flush();
+    return status;
 }
@@ -0,0 +1,231 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+#include <xxhash.h>
+#include "classfile.hpp"
+#include "manifest.hpp"
+#include "trace.hpp"
+
+using std::endl;
+
+static const std::string MANIFEST_HEADER = "myjvm-manifest 1";
+
+uint64_t hash_bytes(const void* data, size_t size)
+{
+    return XXH3_64bits(data, size);
+}
+
+uint64_t hash_file(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return 0;
+    XXH3_state_t* state = XXH3_createState();
+    XXH3_64bits_reset(state);
+    std::vector<char> buffer(1 << 16);
+    while (file) {
+        file.read(buffer.data(), buffer.size());
+        XXH3_64bits_update(state, buffer.data(), file.gcount());
+    }
+    uint64_t result = XXH3_64bits_digest(state);
+    XXH3_freeState(state);
+    return result;
+}
+
+BuildManifest BuildManifest::load(const std::filesystem::path& path)
+{
+    BuildManifest manifest;
+    std::ifstream file(path);
+    if (!file) return manifest;
+    std::string line;
+    if (!std::getline(file, line) || line != MANIFEST_HEADER) return manifest;
+    std::getline(file, manifest.m_filetype);
+    while (std::getline(file, line)) {
+        // Format: <hash hex> <size> <mtime> <path>; the path runs to end of line.
+        std::istringstream fields(line);
+        ManifestEntry entry;
+        std::string file_path;
+        if (!(fields >> std::hex >> entry.hash >> std::dec >> entry.size >> entry.mtime)) continue;
+        fields.get();
+        std::getline(fields, file_path);
+        if (file_path.empty()) continue;
+        manifest.m_entries[file_path] = entry;
+    }
+    return manifest;
+}
+
+bool BuildManifest::save(const std::filesystem::path& path) const
+{
+    std::filesystem::create_directories(path.parent_path());
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Unable to write build manifest: " << temp_path << endl;
+            return false;
+        }
+        file << MANIFEST_HEADER << '\n' << m_filetype << '\n';
+        for (const auto& [file_path, entry] : m_entries) {
+            file << std::hex << entry.hash << std::dec << ' ' << entry.size << ' ' << entry.mtime << ' ' << file_path << '\n';
+        }
+    }
+    // Replace atomically so an interrupted build never leaves a torn manifest.
+    std::filesystem::rename(temp_path, path);
+    return true;
+}
+
+ManifestDiff BuildManifest::update(const std::vector<std::string>& files)
+{
+    TraceScope trace("manifest_update");
+    ManifestDiff diff;
+    std::unordered_set<std::string> seen;
+    for (const std::string& file : files) {
+        seen.insert(file);
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(file, ec);
+        if (ec) continue;
+        int64_t mtime = std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+        if (ec) continue;
+        auto it = m_entries.find(file);
+        if (it != m_entries.end() && it->second.size == size && it->second.mtime == mtime) continue;
+        // Only hash when the cheap stat check fails; a touched but identical
+        // file just refreshes its recorded mtime.
+        uint64_t hash = hash_file(file);
+        if (it == m_entries.end() || it->second.hash != hash) diff.changed.push_back(file);
+        m_entries[file] = {hash, size, mtime};
+    }
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (seen.contains(it->first)) {
+            it++;
+            continue;
+        }
+        diff.removed.push_back(it->first);
+        it = m_entries.erase(it);
+    }
+    return diff;
+}
+
+// Maps a class back to the project source named by its SourceFile attribute.
+// Same-named sources are told apart by the class's package directory; if
+// that is still ambiguous the class is left unattributed.
+static std::string match_source(const ClassFile& cls, 
+                                const std::unordered_map<std::string, std::vector<std::string>>& by_name)
+{
+    auto it = by_name.find(cls.source_file);
+    if (it == by_name.end()) return "";
+    if (it->second.size() == 1) return it->second[0];
+    size_t slash = cls.name.rfind('/');
+    std::string package_dir = slash == std::string::npos ? "" : cls.name.substr(0, slash);
+    std::string match;
+    for (const std::string& source : it->second) {
+        std::string parent = std::filesystem::path(source).parent_path().generic_string();
+        if (package_dir.empty() || !parent.ends_with(package_dir)) continue;
+        if (!match.empty()) return "";
+        match = source;
+    }
+    return match;
+}
+
+AbiIndex AbiIndex::load(const std::filesystem::path& path)
+{
+    AbiIndex index;
+    std::ifstream file(path);
+    if (!file) return index;
+    std::string line;
+    while (std::getline(file, line)) {
+        // Format: <api hex> <constants hex> <class> <source>; the source runs to end of line.
+        std::istringstream fields(line);
+        AbiEntry entry;
+        std::string name;
+        if (!(fields >> std::hex >> entry.api >> entry.constants >> name)) continue;
+        fields.get();
+        std::getline(fields, entry.source);
+        index.m_classes[name] = entry;
+    }
+    return index;
+}
+
+AbiIndex AbiIndex::scan(const std::vector<std::string>& class_files, const std::vector<std::string>& sources)
+{
+    std::unordered_map<std::string, std::vector<std::string>> by_name;
+    for (const std::string& source : sources) {
+        by_name[std::filesystem::path(source).filename().string()].push_back(source);
+    }
+    AbiIndex index;
+    for (const std::string& class_file : class_files) {
+        std::optional<ClassFile> cls = parse_class_file(class_file);
+        if (!cls) continue;
+        AbiEntry entry = {abi_fingerprint(*cls), constants_fingerprint(*cls), match_source(*cls, by_name), std::move(cls->referenced_classes)};
+        index.m_classes[cls->name] = std::move(entry);
+    }
+    return index;
+}
+
+bool AbiIndex::save(const std::filesystem::path& path) const
+{
+    std::filesystem::path temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Unable to write ABI index: " << temp_path << endl;
+            return false;
+        }
+        for (const auto& [name, entry] : m_classes) {
+            file << std::hex << entry.api << ' ' << entry.constants << std::dec << ' ' << name << ' ' << entry.source << '\n';
+        }
+    }
+    std::filesystem::rename(temp_path, path);
+    return true;
+}
+
+// Classes whose API differs from `before`, including ones that appeared or
+// disappeared. Sets `constants_changed` when an inlinable constant moved.
+std::vector<std::string> AbiIndex::changed_since(const AbiIndex& before, bool& constants_changed) const
+{
+    std::vector<std::string> result;
+    constants_changed = false;
+    for (const auto& [name, entry] : m_classes) {
+        auto it = before.m_classes.find(name);
+        if (it == before.m_classes.end()) {
+            result.push_back(name);
+            continue;
+        }
+        if (it->second.constants != entry.constants) constants_changed = true;
+        if (it->second.api != entry.api) result.push_back(name);
+    }
+    for (const auto& [name, entry] : before.m_classes) {
+        if (!m_classes.contains(name)) {
+            result.push_back(name);
+            if (entry.constants != 0) constants_changed = true;
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> AbiIndex::dependents_of(const std::vector<std::string>& classes) const
+{
+    std::unordered_set<std::string> targets(classes.begin(), classes.end());
+    std::unordered_set<std::string> sources;
+    for (const auto& [name, entry] : m_classes) {
+        if (entry.source.empty()) continue;
+        for (const std::string& reference : entry.references) {
+            if (targets.contains(reference)) {
+                sources.insert(entry.source);
+                break;
+            }
+        }
+    }
+    return {sources.begin(), sources.end()};
+}
+
+std::vector<std::string> AbiIndex::classes_from(const std::vector<std::string>& sources) const
+{
+    std::unordered_set<std::string> wanted(sources.begin(), sources.end());
+    std::vector<std::string> result;
+    for (const auto& [name, entry] : m_classes) {
+        if (wanted.contains(entry.source)) result.push_back(name);
+    }
+    return result;
+}
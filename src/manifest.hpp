@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Persistent record of the sources that produced the contents of out/.
+// Each entry keeps a content hash plus the size and mtime seen when it was
+// hashed, so unchanged files are recognised from a stat alone.
+
+struct ManifestEntry
+{
+    uint64_t hash;
+    uint64_t size;
+    int64_t mtime;
+    bool operator==(const ManifestEntry&) const = default;
+};
+
+struct ManifestDiff
+{
+    std::vector<std::string> changed;  // added or modified since the last build
+    std::vector<std::string> removed;
+    bool empty() const { return changed.empty() && removed.empty(); }
+};
+
+class BuildManifest
+{
+private:
+    // Fields
+    std::string m_filetype;
+    std::unordered_map<std::string, ManifestEntry> m_entries;
+public:
+    static BuildManifest load(const std::filesystem::path& path);
+    bool save(const std::filesystem::path& path) const;
+    ManifestDiff update(const std::vector<std::string>& files);
+    inline const std::string& filetype() const { return m_filetype; }
+    inline void set_filetype(const std::string& filetype) { m_filetype = filetype; }
+    inline size_t size() const { return m_entries.size(); }
+};
+
+// Per-class API fingerprints from the last build, used to decide whether the
+// dependents of a recompiled class need recompiling too.
+
+struct AbiEntry
+{
+    uint64_t api;
+    uint64_t constants;
+    std::string source;  // project source the class came from, if known
+    std::vector<std::string> references;  // only populated by scan()
+};
+
+class AbiIndex
+{
+private:
+    // Fields
+    std::unordered_map<std::string, AbiEntry> m_classes;
+public:
+    static AbiIndex load(const std::filesystem::path& path);
+    static AbiIndex scan(const std::vector<std::string>& class_files, const std::vector<std::string>& sources);
+    bool save(const std::filesystem::path& path) const;
+    std::vector<std::string> changed_since(const AbiIndex& before, bool& constants_changed) const;
+    std::vector<std::string> dependents_of(const std::vector<std::string>& classes) const;
+    std::vector<std::string> classes_from(const std::vector<std::string>& sources) const;
+};
+
+uint64_t hash_file(const std::filesystem::path& path);
+uint64_t hash_bytes(const void* data, size_t size);
+
+inline const std::filesystem::path MANIFEST_PATH = "out/.myjvm-manifest";
+inline const std::filesystem::path ABI_PATH = "out/.myjvm-abi";
+inline const std::filesystem::path CDS_DIR = "out/.myjvm-cds";
+inline const std::filesystem::path MODULES_PATH = "out/.myjvm-modules";
@@ -1,4 +1,20 @@
+#include <algorithm>
+#include <fstream>
 #include "os.hpp"
+#include "trace.hpp"
+
+#if OS_UNIX_LIKE_DEFINED
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <spawn.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+
+    extern char** environ;
+#endif
+
+static const size_t PUMP_BUFFER_SIZE = 1 << 16;
 
 std::string OS::detect_os()
 {
@@ -20,71 +36,177 @@ std::string OS::detect_os()
 }
 
 #if OS_UNIX_LIKE_DEFINED
-std::pair<int, std::string> OS::run_command_unix(const std::vector<std::string>& args)
+static int decode_status(int status)
+{
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    return -1;  // killed by a signal
+}
+
+// Close-on-exec so a child only inherits the ends it was handed via dup2.
+// pipe2 sets it atomically; with pipe+fcntl a spawn on another thread could
+// slip in between and leak a write end, so its reader never sees EOF.
+static bool make_pipe(int fds[2])
+{
+    #if defined(OS_LINUX) || defined(OS_FREEBSD)
+        return pipe2(fds, O_CLOEXEC) == 0;
+    #else
+        if (pipe(fds) == -1) return false;
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return true;
+    #endif
+}
+
+Process::Process(pid_t pid, int stdout_fd, int stderr_fd) : m_pid(pid), m_stdout(stdout_fd), m_stderr(stderr_fd)
+{
+}
+
+Process::Process(Process&& other) noexcept
+    : m_pid(other.m_pid), m_status(other.m_status), m_reaped(other.m_reaped), m_stdout(other.m_stdout), m_stderr(other.m_stderr)
+{
+    other.m_pid = -1;
+    other.m_stdout = -1;
+    other.m_stderr = -1;
+}
+
+Process& Process::operator=(Process&& other) noexcept
+{
+    if (this == &other) return *this;
+    release();
+    m_pid = other.m_pid;
+    m_status = other.m_status;
+    m_reaped = other.m_reaped;
+    m_stdout = other.m_stdout;
+    m_stderr = other.m_stderr;
+    other.m_pid = -1;
+    other.m_stdout = -1;
+    other.m_stderr = -1;
+    return *this;
+}
+
+Process::~Process()
+{
+    release();
+}
+
+void Process::release()
+{
+    if (m_stdout != -1) close(m_stdout);
+    if (m_stderr != -1) close(m_stderr);
+    m_stdout = -1;
+    m_stderr = -1;
+    if (valid() && !m_reaped) wait();
+    m_pid = -1;
+}
+
+std::optional<int> Process::poll()
 {
-    // Convert std::vector<std::string> to an array of char* required by execvp
-    std::vector<char*> cargs;
-    for (const std::string& arg : args) {
-        cargs.push_back(strdup(arg.c_str()));
+    if (!valid()) return std::nullopt;
+    if (m_reaped) return m_status;
+    int status;
+    pid_t ret = waitpid(m_pid, &status, WNOHANG);
+    if (ret != m_pid) return std::nullopt;
+    m_reaped = true;
+    m_status = decode_status(status);
+    return m_status;
+}
+
+int Process::wait()
+{
+    if (!valid()) return -1;
+    if (m_reaped) return m_status;
+    int status;
+    while (waitpid(m_pid, &status, 0) == -1) {
+        if (errno != EINTR) return -1;
     }
-    cargs.push_back(nullptr);  // execvp expects a null-terminated array
-    int pipefd[2];  // Pipe for capturing output
-    if (pipe(pipefd) == -1) {
+    m_reaped = true;
+    m_status = decode_status(status);
+    return m_status;
+}
+
+bool Process::kill(int signal)
+{
+    if (!valid() || m_reaped) return false;
+    return ::kill(m_pid, signal) == 0;
+}
+
+bool Process::kill_group(int signal)
+{
+    if (!valid()) return false;
+    return ::kill(-m_pid, signal) == 0;
+}
+
+Process OS::spawn(const std::vector<std::string>& args, Stdio out, Stdio err,
+                  const std::filesystem::path& cwd, bool new_group)
+{
+    if (args.empty()) return Process();
+    int out_pipe[2] = {-1, -1};
+    int err_pipe[2] = {-1, -1};
+    if ((out == Stdio::Pipe && !make_pipe(out_pipe)) || (err == Stdio::Pipe && !make_pipe(err_pipe))) {
         perror("pipe failed");
-        return {-1, ""};
-    }
-    pid_t pid = fork();  // Fork the current process
-    if (pid == -1) {
-        // Error occurred during fork
-        perror("fork failed");
-        return {-1, ""};
-    }
-    else if (pid == 0) {
-        // Child process: redirect stdout to the pipe
-        close(pipefd[0]);  // Close unused read end
-        dup2(pipefd[1], STDOUT_FILENO);  // Redirect stdout to pipe write end
-        dup2(pipefd[1], STDERR_FILENO);  // Optionally redirect stderr to pipe write end
-        close(pipefd[1]);  // Close original write end after duplication
-
-		std::string full_command;
-		for (const auto& arg : args) {
-        if (!full_command.empty()) full_command += " ";
-        full_command += "'" + arg + "'";  // WRAP EACH ARG IN SINGLE QUOTES
-    }
-		const char* bash_args[] = {"/bin/bash", "-c", full_command.c_str(), nullptr};
-		execvp(bash_args[0], const_cast<char* const*>(bash_args));
-
-        // execvp only returns if an error occurred
-        perror("execvp failed");
-        exit(EXIT_FAILURE);
-    }
-    else {
-        // Parent process
-        close(pipefd[1]);  // Close unused write end
-        // Read output from the pipe
-        std::string output;
-        char buffer[128];
-        ssize_t bytesRead;
-        while ((bytesRead = read(pipefd[0], buffer, sizeof(buffer) - 1)) > 0) {
-            buffer[bytesRead] = '\0';
-            output += buffer;
-        }
-        close(pipefd[0]);  // Close read end when done
-        // Wait for the child process to finish
-        int status;
-        waitpid(pid, &status, 0);  // Wait for the child process to terminate
-        // Free allocated memory for cargs
-        for (char* carg : cargs) {
-            free(carg);
-        }
-        // Return child's exit status and captured output
-        if (WIFEXITED(status)) {
-            return {WEXITSTATUS(status), output};  // Return exit code and output
-        }
-        else {
-            return {-1, output};  // Child did not exit normally, return -1 with captured output
-        }
+        for (int fd : {out_pipe[0], out_pipe[1]}) if (fd != -1) close(fd);
+        return Process();
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (out == Stdio::Pipe) posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    else if (out == Stdio::Null) posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    if (err == Stdio::Pipe) posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+    else if (err == Stdio::Null) posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    else if (err == Stdio::MergeWithStdout) posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    if (!cwd.empty()) posix_spawn_file_actions_addchdir_np(&actions, cwd.c_str());
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    // We may be ignoring SIGPIPE; the child should not inherit that.
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &default_signals);
+    short flags = POSIX_SPAWN_SETSIGDEF;
+    if (new_group) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attributes, 0);
+    }
+    posix_spawnattr_setflags(&attributes, flags);
+    std::vector<char*> argv;
+    for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    // Anything still buffered would otherwise show up after the child's output.
+    std::cout.flush();
+    pid_t pid;
+    int rc = posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    if (out_pipe[1] != -1) close(out_pipe[1]);
+    if (err_pipe[1] != -1) close(err_pipe[1]);
+    if (rc != 0) {
+        std::cerr << "Failed to launch " << args[0] << ": " << strerror(rc) << std::endl;
+        if (out_pipe[0] != -1) close(out_pipe[0]);
+        if (err_pipe[0] != -1) close(err_pipe[0]);
+        return Process();
+    }
+    return Process(pid, out_pipe[0], err_pipe[0]);
+}
+
+std::pair<int, std::string> OS::run_command_unix(const std::vector<std::string>& args)
+{
+    TraceScope trace("child");
+    trace.arg("command", args.empty() ? "" : args[0]);
+    Process process = OS::spawn(args, Stdio::Pipe, Stdio::MergeWithStdout);
+    if (!process.valid()) return {-1, ""};
+    trace.arg("pid", process.pid());
+    std::string output;
+    std::vector<char> buffer(PUMP_BUFFER_SIZE);
+    while (true) {
+        ssize_t n = read(process.stdout_fd(), buffer.data(), buffer.size());
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        output.append(buffer.data(), n);
     }
+    int status = process.wait();
+    trace.arg("status", status);
+    trace.arg("output_bytes", output.size());
+    return {status, output};
 }
 #elif OS_WINDOWS_DEFINED || !OS_UNIX_LIKE_DEFINED
 std::pair<int, std::string> OS::run_command_windows(const std::string& command)
@@ -159,25 +281,217 @@ std::pair<int, std::string> OS::run_command_windows(const std::string& command)
 }
 #endif
 
-std::pair<int, std::string> OS::run_command(std::string& arg)
+#if OS_UNIX_LIKE_DEFINED
+static volatile sig_atomic_t stop_signal = 0;
+
+static void record_stop_signal(int signal)
 {
-    std::pair<int, std::string> result;
-    std::vector<std::string> args = split_preserve_quotes(arg, ' ');
-    #if defined(OS_UNIX_LIKE)
-        result = OS::run_command_unix(args);
+    stop_signal = signal;
+}
+#endif
+
+void OS::catch_stop_signals()
+{
+    #if OS_UNIX_LIKE_DEFINED
+        struct sigaction action = {};
+        action.sa_handler = record_stop_signal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+    #endif
+}
+
+bool OS::stop_requested()
+{
+    #if OS_UNIX_LIKE_DEFINED
+        return stop_signal != 0;
     #else
-        result = OS::run_command_windows(arg);
+        return false;
     #endif
-    return result;
 }
 
-// Overload: run_command(vector<string>)
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    #if OS_UNIX_LIKE_DEFINED
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return;
+    }
+    m_size = st.st_size;
+    m_ok = true;
+    if (m_size > 0) {
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) m_ok = false;
+        else {
+            m_data = static_cast<const uint8_t*>(data);
+            m_mapped = true;
+        }
+    }
+    close(fd);
+    #else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return;
+    m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    m_ok = true;
+    #endif
+}
+
+MappedFile::~MappedFile()
+{
+    #if OS_UNIX_LIKE_DEFINED
+    if (m_mapped) munmap(const_cast<uint8_t*>(m_data), m_size);
+    #endif
+}
+
+OutputTail::OutputTail(size_t limit) : m_limit(limit)
+{
+    m_buffer.resize(limit);
+}
+
+void OutputTail::append(const char* data, size_t size)
+{
+    if (m_limit == 0) return;
+    if (size >= m_limit) {
+        std::memcpy(m_buffer.data(), data + size - m_limit, m_limit);
+        m_pos = 0;
+        m_wrapped = true;
+        return;
+    }
+    size_t first = std::min(size, m_limit - m_pos);
+    std::memcpy(m_buffer.data() + m_pos, data, first);
+    std::memcpy(m_buffer.data(), data + first, size - first);
+    if (m_pos + size >= m_limit) m_wrapped = true;
+    m_pos = (m_pos + size) % m_limit;
+}
+
+std::string OutputTail::str() const
+{
+    if (!m_wrapped) return m_buffer.substr(0, m_pos);
+    return m_buffer.substr(m_pos) + m_buffer.substr(0, m_pos);
+}
+
+#if OS_UNIX_LIKE_DEFINED
+// Returns false once the sink stops taking data (EPIPE when nobody reads it).
+static bool write_all(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// One stream of a child: `source` is the read end of its pipe, `sink` the
+// fd it is forwarded to. Pipes and files take the data via splice, without
+// it passing through our memory, unless the stream is being captured.
+// Once the sink is gone (`myjvm proj | head -1`) the child is still drained,
+// so it never blocks on a full pipe, but nothing more is forwarded.
+struct OutputPump
+{
+    int source;
+    int sink;
+    OutputTail* tail;
+    bool use_splice;
+    uint64_t bytes = 0;
+    bool forward = true;
+};
+
+// Moves whatever is available; returns false once the child closed its end.
+static bool pump_output(OutputPump& pump, std::vector<char>& buffer)
+{
+    #if defined(OS_LINUX)
+    if (pump.use_splice) {
+        ssize_t n = splice(pump.source, nullptr, pump.sink, nullptr, 1 << 20, SPLICE_F_MOVE | SPLICE_F_MORE);
+        pump.bytes += std::max<ssize_t>(n, 0);
+        if (n >= 0) return n > 0;
+        if (errno == EINTR || errno == EAGAIN) return true;
+        if (errno == EPIPE) pump.forward = false;
+        pump.use_splice = false;  // e.g. an O_APPEND file; fall back to copying
+    }
+    #endif
+    ssize_t n = read(pump.source, buffer.data(), buffer.size());
+    if (n == -1) return errno == EINTR || errno == EAGAIN;
+    if (n == 0) return false;
+    pump.bytes += n;
+    if (pump.tail) pump.tail->append(buffer.data(), n);
+    if (pump.forward && !write_all(pump.sink, buffer.data(), n)) pump.forward = false;
+    return true;
+}
+
+static bool splice_target(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1) return false;
+    return S_ISFIFO(st.st_mode) || S_ISREG(st.st_mode);
+}
+
+int OS::run_command_streaming(const std::vector<std::string>& args, OutputTail* stderr_tail)
+{
+    TraceScope trace("child");
+    trace.arg("command", args.empty() ? "" : args[0]);
+    // A closed stdout must surface as EPIPE from write/splice rather than
+    // killing us mid-pump; children get the default action back in spawn.
+    signal(SIGPIPE, SIG_IGN);
+    Process process = OS::spawn(args, Stdio::Pipe, Stdio::Pipe);
+    if (!process.valid()) return -1;
+    trace.arg("pid", process.pid());
+    uint64_t written[2] = {0, 0};
+    std::vector<OutputPump> pumps = {
+        {process.stdout_fd(), STDOUT_FILENO, nullptr, splice_target(STDOUT_FILENO)},
+        {process.stderr_fd(), STDERR_FILENO, stderr_tail, !stderr_tail && splice_target(STDERR_FILENO)},
+    };
+    std::vector<char> buffer(PUMP_BUFFER_SIZE);
+    while (!pumps.empty()) {
+        std::vector<pollfd> fds;
+        for (const OutputPump& pump : pumps) fds.push_back({pump.source, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) continue;
+            perror("poll failed");
+            break;
+        }
+        for (size_t i = fds.size(); i-- > 0;) {
+            if (fds[i].revents == 0) continue;
+            if (pump_output(pumps[i], buffer)) continue;
+            written[pumps[i].sink == STDOUT_FILENO ? 0 : 1] = pumps[i].bytes;
+            pumps.erase(pumps.begin() + i);
+        }
+    }
+    int status = process.wait();
+    trace.arg("status", status);
+    trace.arg("stdout_bytes", written[0]);
+    trace.arg("stderr_bytes", written[1]);
+    return status;
+}
+#else
+int OS::run_command_streaming(const std::vector<std::string>& args, OutputTail* stderr_tail)
+{
+    std::pair<int, std::string> result = OS::run_command(args);
+    std::cout << result.second;
+    if (stderr_tail) stderr_tail->append(result.second.data(), result.second.size());
+    return result.first;
+}
+#endif
+
 std::pair<int, std::string> OS::run_command(const std::vector<std::string>& args)
 {
     #if defined(OS_UNIX_LIKE)
         return OS::run_command_unix(args);
     #else
-        return OS::run_command_windows(args);  // You can stub this if needed
+        std::string command;
+        for (const std::string& arg : args) {
+            if (!command.empty()) command += " ";
+            command += "\"" + arg + "\"";
+        }
+        return OS::run_command_windows(command);
     #endif
 }
 
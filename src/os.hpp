@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <filesystem>
 #include <iostream>
+#include <optional>
 #include <vector>
 #include <string>
 #include <cstring>
@@ -25,6 +28,7 @@
 #endif
 
 #if defined(OS_MACOS) || defined(OS_LINUX) || defined(OS_UNIX) || defined(OS_FREEBSD)
+    #include <csignal>
     #include <unistd.h>
     #include <sys/wait.h>  // for waitpid
     #define OS_UNIX_LIKE
@@ -51,12 +55,107 @@
     #endif
 #endif
 
+// Keeps the last `limit` bytes written to it, for diagnostics about a
+// child whose output was streamed rather than collected.
+class OutputTail
+{
+private:
+    // Fields
+    std::string m_buffer;
+    size_t m_limit;
+    size_t m_pos = 0;
+    bool m_wrapped = false;
+public:
+    explicit OutputTail(size_t limit = 64 << 10);
+    void append(const char* data, size_t size);
+    std::string str() const;
+};
+
+// Read-only view of a whole file: memory-mapped where the platform allows,
+// read into memory otherwise.
+class MappedFile
+{
+private:
+    // Fields
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_mapped = false;
+    bool m_ok = false;
+    std::vector<uint8_t> m_buffer;
+public:
+    explicit MappedFile(const std::filesystem::path& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+    inline bool ok() const { return m_ok; }
+    inline const uint8_t* data() const { return m_data; }
+    inline size_t size() const { return m_size; }
+};
+
+#if OS_UNIX_LIKE_DEFINED
+// Where a spawned child's stdout or stderr goes.
+enum class Stdio
+{
+    Inherit,
+    Pipe,             // readable through the Process handle
+    Null,
+    MergeWithStdout,  // stderr only: share whatever stdout was given
+};
+
+// Handle to a child started by OS::spawn. It owns the read ends of any piped
+// streams. Destroying a handle whose child is still running waits for it.
+class Process
+{
+private:
+    // Fields
+    pid_t m_pid = -1;
+    int m_status = -1;
+    bool m_reaped = false;
+    int m_stdout = -1;
+    int m_stderr = -1;
+
+    void release();
+public:
+    Process() = default;
+    Process(pid_t pid, int stdout_fd, int stderr_fd);
+    Process(Process&& other) noexcept;
+    Process& operator=(Process&& other) noexcept;
+    Process(const Process&) = delete;
+    Process& operator=(const Process&) = delete;
+    ~Process();
+    inline bool valid() const { return m_pid > 0; }
+    inline pid_t pid() const { return m_pid; }
+    inline int stdout_fd() const { return m_stdout; }
+    inline int stderr_fd() const { return m_stderr; }
+    std::optional<int> poll();  // exit status if the child has finished
+    int wait();
+    bool kill(int signal = SIGTERM);
+    bool kill_group(int signal = SIGKILL);  // for children spawned with new_group
+};
+#endif
+
 class OS
 {
 public:
     static std::string detect_os();
-    static std::pair<int, std::string> run_command(std::string& args);
     static std::pair<int, std::string> run_command(const std::vector<std::string>& args);
+    // Passes the child's stdout and stderr through to ours as they arrive,
+    // keeping only the tail of stderr, and returns its exit status.
+    static int run_command_streaming(const std::vector<std::string>& args, OutputTail* stderr_tail = nullptr);
+    #if OS_UNIX_LIKE_DEFINED
+    // Starts args[0] (searched on PATH) with `args` as its argv, directly
+    // and without a shell, in `cwd` if one is given. With `new_group` the
+    // child leads a process group of its own, so it and everything it
+    // starts can be stopped together. Returns an invalid handle if it could
+    // not start.
+    static Process spawn(const std::vector<std::string>& args, Stdio out = Stdio::Inherit, Stdio err = Stdio::Inherit,
+                         const std::filesystem::path& cwd = {}, bool new_group = false);
+    #endif
+    // Turns SIGINT and SIGTERM into a request to stop that long-running
+    // commands check, so they return through main and the trace is written.
+    // A blocked poll() wakes with EINTR. Does nothing off Unix.
+    static void catch_stop_signals();
+    static bool stop_requested();
 private:
     static std::pair<int, std::string> run_command_unix(const std::vector<std::string>& args);
     static std::pair<int, std::string> run_command_windows(const std::string& command);
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "manifest.hpp"
+#include "os.hpp"
+#include "prewarm.hpp"
+#include "runtime.hpp"
+#include "trace.hpp"
+#include "utils.hpp"
+
+using std::cout;
+using std::endl;
+
+// A snippet per compiler that touches the usual parts of the front end and
+// code generation: classes, generics, lambdas, collections and strings.
+struct PrewarmSnippet
+{
+    std::string language;
+    std::string component;
+    std::string file_name;
+    std::string source;
+};
+
+static const std::vector<PrewarmSnippet> SNIPPETS = {
+    {"java", "jvm-runtime-standard", "Prewarm.java", R"(
+import java.util.*;
+import java.util.stream.*;
+
+public class Prewarm {
+    record Point(int x, int y) {}
+    interface Shape { double area(); }
+    static <T extends Comparable<T>> T max(List<T> items) { return Collections.max(items); }
+    public static void main(String[] args) {
+        List<Point> points = IntStream.range(0, 10).mapToObj(i -> new Point(i, i * i)).collect(Collectors.toList());
+        Map<Integer, String> names = new HashMap<>();
+        for (Point p : points) names.put(p.x(), String.format("%d:%d", p.x(), p.y()));
+        Shape circle = () -> Math.PI;
+        System.out.println(max(new ArrayList<>(names.keySet())) + " " + circle.area());
+    }
+}
+)"},
+    {"scala", "scala-compiler-jars", "Prewarm.scala", R"(
+case class Point(x: Int, y: Int)
+trait Shape { def area: Double }
+enum Color { case Red, Green }
+
+object Prewarm {
+  def max[T: Ordering](items: List[T]): T = items.max
+  def main(args: Array[String]): Unit = {
+    val points = (0 until 10).map(i => Point(i, i * i)).toList
+    val names = points.map(p => p.x -> s"${p.x}:${p.y}").toMap
+    val circle = new Shape { def area = math.Pi }
+    println(s"${max(names.keys.toList)} ${circle.area} ${Color.Red}")
+  }
+}
+)"},
+    {"kotlin", "kotlin-compiler", "Prewarm.kt", R"(
+data class Point(val x: Int, val y: Int)
+interface Shape { fun area(): Double }
+enum class Color { RED, GREEN }
+
+fun <T : Comparable<T>> max(items: List<T>): T = items.maxOrNull()!!
+
+fun main() {
+    val points = (0 until 10).map { Point(it, it * it) }
+    val names = points.associate { it.x to "${it.x}:${it.y}" }
+    val circle = object : Shape { override fun area() = Math.PI }
+    println("${max(names.keys.toList())} ${circle.area()} ${Color.RED}")
+}
+)"},
+};
+
+std::filesystem::path compiler_archive_path(const std::string& language)
+{
+    return runtime_path("cds/" + language + ".jsa");
+}
+
+// Left in the store when a prewarm fails, holding the version of the snippet
+// that failed; runs skip the compiler until `myjvm prewarm` succeeds.
+static std::filesystem::path failure_marker_path(const std::string& language)
+{
+    return runtime_path("cds/" + language + ".failed");
+}
+
+static std::string snippet_version(const PrewarmSnippet& snippet)
+{
+    char version[20];
+    std::snprintf(version, sizeof(version), "%016llx", static_cast<unsigned long long>(hash_bytes(snippet.source.data(), snippet.source.size())));
+    return version;
+}
+
+static bool prewarm_failed_before(const PrewarmSnippet& snippet)
+{
+    std::ifstream ifs(failure_marker_path(snippet.language));
+    std::string version;
+    return ifs && std::getline(ifs, version) && version == snippet_version(snippet);
+}
+
+// CDS reports classes it cannot archive on stdout; compiler output is parsed
+// for errors, so keep that out of it.
+static const std::string QUIET_CDS = "-Xlog:cds=off,cds+dynamic=off";
+
+std::vector<std::string> compiler_jvm_options(const std::string& language)
+{
+    std::filesystem::path archive = compiler_archive_path(language);
+    if (!std::filesystem::exists(archive)) return {};
+    return {"-XX:SharedArchiveFile=" + archive.string(), QUIET_CDS};
+}
+
+bool prewarm_compiler(const std::string& language, bool force)
+{
+    auto snippet = std::find_if(SNIPPETS.begin(), SNIPPETS.end(), [&](const PrewarmSnippet& s) { return s.language == language; });
+    if (snippet == SNIPPETS.end()) {
+        std::cerr << "No compiler to prewarm for " << language << endl;
+        return false;
+    }
+    std::filesystem::path archive = compiler_archive_path(language);
+    if (!force && std::filesystem::exists(archive)) return true;
+    TraceScope trace("prewarm_compiler");
+    trace.arg("language", language);
+    // The store is shared, so work in a private directory and rename the
+    // finished archive into place.
+    std::filesystem::path staging = runtime_path(".tmp-prewarm-" + language + "-" + std::to_string(getpid()));
+    std::filesystem::remove_all(staging);
+    std::filesystem::create_directories(staging / "out");
+    std::filesystem::path source = staging / snippet->file_name;
+    std::ofstream ofs(source);
+    if (!ofs) {
+        std::cerr << "Unable to write prewarm source: " << source << endl;
+        std::filesystem::remove_all(staging);
+        return false;
+    }
+    ofs << snippet->source;
+    ofs.close();
+    std::filesystem::path dump = staging / (language + ".jsa");
+    std::vector<std::string> command = compiler_launcher(language, {"-XX:ArchiveClassesAtExit=" + dump.string(), QUIET_CDS});
+    command.insert(command.end(), {"-d", (staging / "out").string(), source.string()});
+    std::pair<int, std::string> res = OS::run_command(command);
+    bool ok = res.first == 0 && std::filesystem::exists(dump);
+    std::filesystem::create_directories(archive.parent_path());
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(dump, archive, ec);
+        ok = !ec;
+    }
+    else std::cerr << "Unable to prewarm the " << language << " compiler: " << res.second << endl;
+    std::filesystem::remove_all(staging);
+    if (ok) std::filesystem::remove(failure_marker_path(language), ec);
+    // An interrupted prewarm is simply tried again on the next run.
+    else if (!OS::stop_requested()) std::ofstream(failure_marker_path(language)) << snippet_version(*snippet) << '\n';
+    return ok;
+}
+
+// Called with the components a run needs. Any of their compilers without an
+// archive is prewarmed, so one that was interrupted is retried; one that
+// failed is left alone until `myjvm prewarm` is run.
+void prewarm_components(const std::vector<std::string>& components)
+{
+    for (const PrewarmSnippet& snippet : SNIPPETS) {
+        if (std::find(components.begin(), components.end(), snippet.component) == components.end()) continue;
+        if (std::filesystem::exists(compiler_archive_path(snippet.language))) continue;
+        if (prewarm_failed_before(snippet)) continue;
+        cout << "Prewarming the " << snippet.language << " compiler..." << endl;
+        prewarm_compiler(snippet.language);
+    }
+}
+
+int run_prewarm_command()
+{
+    std::vector<std::string> components;
+    for (const PrewarmSnippet& snippet : SNIPPETS) components.push_back(snippet.component);
+    ensure_runtime(components);
+    int status = 0;
+    for (const PrewarmSnippet& snippet : SNIPPETS) {
+        cout << "Prewarming the " << snippet.language << " compiler..." << endl;
+        if (prewarm_compiler(snippet.language, true)) cout << "  " << compiler_archive_path(snippet.language).string() << endl;
+        else status = 1;
+    }
+    return status;
+}
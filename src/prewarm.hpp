@@ -0,0 +1,17 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Class data sharing archives for the bundled compilers. Prewarming compiles
+// a small snippet with each compiler while the JVM records the classes it
+// loads into <store>/cds/<language>.jsa; every later compiler launch maps
+// that archive instead of loading javac, dotty or kotlinc class by class.
+// Languages are "java", "scala" and "kotlin".
+
+std::filesystem::path compiler_archive_path(const std::string& language);
+std::vector<std::string> compiler_jvm_options(const std::string& language);
+bool prewarm_compiler(const std::string& language, bool force = false);
+void prewarm_components(const std::vector<std::string>& components);
+int run_prewarm_command();
@@ -0,0 +1,105 @@
+#include <optional>
+#include <set>
+#include "project.hpp"
+#include "trace.hpp"
+#include "walker.hpp"
+
+static const std::filesystem::path OUT_DIR = "out";
+
+static std::string extension_of(const std::string& path)
+{
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos) return "";
+    return path.substr(dot);
+}
+
+std::string source_type(const std::string& path)
+{
+    std::string ext = extension_of(path);
+    if (ext == ".scala" || ext == ".sc") return ".scala";
+    else if (ext == ".java") return ".java";
+    else if (ext == ".kt") return ".kt";
+    return "";
+}
+
+static std::vector<std::string> scan_class_files()
+{
+    WalkOptions options;
+    options.gitignore = false;  // out/ is usually ignored, and it is ours anyway
+    std::vector<std::string> result;
+    for (std::string& file : walk_files(OUT_DIR, options)) {
+        if (file.ends_with(".class")) result.push_back(std::move(file));
+    }
+    return result;
+}
+
+ProjectIndex ProjectIndex::scan(const std::filesystem::path& root)
+{
+    TraceScope trace("project_scan");
+    ProjectIndex index;
+    index.root = std::filesystem::absolute(root).lexically_normal();
+    WalkOptions options;
+    options.ignore = {".languages/"};
+    // out/ is walked on its own for class files; keep it out of the source walk.
+    std::filesystem::path out_dir = std::filesystem::absolute(OUT_DIR).lexically_normal();
+    std::filesystem::path out_relative = out_dir.lexically_relative(index.root);
+    if (!out_relative.empty() && *out_relative.begin() != "..") options.ignore.push_back("/" + out_relative.generic_string() + "/");
+    std::set<std::string> languages;
+    WalkResult walk = walk_tree(root, options);
+    index.directories = std::move(walk.directories);
+    for (std::string& file : walk.files) {
+        std::string type = source_type(file);
+        if (type.empty() || extension_of(file) != type) continue;
+        languages.insert(type);
+        index.sources.push_back(std::move(file));
+    }
+    for (const std::string& language : languages) {
+        index.filetype = index.filetype == "UNKNOWN" ? language : index.filetype + "+" + language;
+    }
+    index.class_files = scan_class_files();
+    trace.arg("sources", index.sources.size());
+    trace.arg("class_files", index.class_files.size());
+    return index;
+}
+
+// ".java+.scala" -> {".java", ".scala"}; empty for "UNKNOWN".
+std::vector<std::string> filetype_languages(const std::string& filetype)
+{
+    std::vector<std::string> languages;
+    size_t start = 0;
+    while (start < filetype.size()) {
+        size_t end = filetype.find('+', start);
+        if (end == std::string::npos) end = filetype.size();
+        std::string language = filetype.substr(start, end - start);
+        if (!source_type(language).empty()) languages.push_back(language);
+        start = end + 1;
+    }
+    return languages;
+}
+
+static std::optional<ProjectIndex>& cached_index()
+{
+    static std::optional<ProjectIndex> index;
+    return index;
+}
+
+const ProjectIndex& project_index(const std::filesystem::path& root)
+{
+    std::optional<ProjectIndex>& index = cached_index();
+    if (!index || index->root != std::filesystem::absolute(root).lexically_normal()) index = ProjectIndex::scan(root);
+    if (index->class_files_stale) {
+        index->class_files = scan_class_files();
+        index->class_files_stale = false;
+    }
+    return *index;
+}
+
+void invalidate_class_files()
+{
+    if (cached_index()) cached_index()->class_files_stale = true;
+}
+
+void invalidate_project_index()
+{
+    cached_index().reset();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// What a run needs to know about the project tree: its languages, its
+// sources and the class files in out/. The source walk honours .gitignore
+// files and prunes the directories the tool owns (.languages/ and out/);
+// out/ is walked separately for class files. The index is shared by every
+// caller for the rest of the run; compiling only invalidates the class
+// files, which are then rescanned from out/ alone.
+
+struct ProjectIndex
+{
+    std::filesystem::path root;  // absolute
+    std::string filetype = "UNKNOWN";  // the source extensions present, joined by '+': ".java+.scala"
+    std::vector<std::string> sources;  // .java, .kt and .scala files, as paths under the root given
+    std::vector<std::string> directories;  // the root and every directory the source walk went into
+    std::vector<std::string> class_files;  // "out/..." paths
+    bool class_files_stale = false;
+
+    static ProjectIndex scan(const std::filesystem::path& root);
+};
+
+// The language a path's extension belongs to (".sc" is Scala), or "".
+std::string source_type(const std::string& path);
+std::vector<std::string> filetype_languages(const std::string& filetype);
+const ProjectIndex& project_index(const std::filesystem::path& root = ".");
+void invalidate_class_files();
+void invalidate_project_index();
@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <archive.h>
+#include <archive_entry.h>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <zstd.h>
+#include "extractor.hpp"
+#include "integrity.hpp"
+#include "jar.hpp"
+#include "langpack.hpp"
+#include "manifest.hpp"
+#include "os.hpp"
+#include "project.hpp"
+#include "runtime.hpp"
+#include "trace.hpp"
+
+#if OS_UNIX_LIKE_DEFINED
+    #include <fcntl.h>
+    #include <sys/file.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+extern const unsigned char _binary__languages_tar_zst_start[];
+extern const unsigned char _binary__languages_tar_zst_end[];
+
+// Feeds the embedded archive to libarchive straight from memory, inflating
+// it through a ZSTD stream as libarchive asks for more data.
+struct ZstdMemorySource
+{
+    ZSTD_DStream* stream;
+    ZSTD_inBuffer input;
+    std::vector<char> buffer;
+    size_t pending;  // last ZSTD_decompressStream hint; 0 once a frame is complete
+};
+
+static la_ssize_t zstd_memory_read(struct archive* a, void* client_data, const void** out)
+{
+    ZstdMemorySource* source = static_cast<ZstdMemorySource*>(client_data);
+    ZSTD_outBuffer output = { source->buffer.data(), source->buffer.size(), 0 };
+    while (output.pos == 0) {
+        if (source->input.pos == source->input.size && source->pending == 0) break;
+        size_t consumed = source->input.pos;
+        size_t ret = ZSTD_decompressStream(source->stream, &output, &source->input);
+        if (ZSTD_isError(ret)) {
+            std::cerr << "Decompression error: " << ZSTD_getErrorName(ret) << endl;
+            return ARCHIVE_FATAL;
+        }
+        source->pending = ret;
+        // No input consumed and nothing produced: the archive is truncated.
+        if (output.pos == 0 && source->input.pos == consumed) break;
+    }
+    *out = source->buffer.data();
+    return output.pos;
+}
+
+// Entries are written under `output_dir` with `strip_prefix` removed from
+// their names; entries outside the prefix, or outside `only` when it is not
+// empty, are skipped. File bodies are read here and written out by an
+// ExtractionWriter with their archived modes.
+static void extract_entries(struct archive* a, const std::string& output_dir, const std::string& strip_prefix, 
+                            const std::unordered_set<std::string>& only = {})
+{
+    ExtractionWriter writer;
+    archive_entry* entry;
+    while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
+        std::string name = archive_entry_pathname(entry);
+        if (!name.starts_with(strip_prefix)) continue;
+        name.erase(0, strip_prefix.size());
+        if (name.empty()) continue;
+        if (!only.empty() && !only.contains(name)) continue;
+        std::filesystem::path full_path = std::filesystem::path(output_dir) / name;
+        mode_t mode = archive_entry_perm(entry);
+        auto type = archive_entry_filetype(entry);
+        if (type == AE_IFDIR) {
+            writer.add_directory(full_path, mode);
+        } 
+        else if (type == AE_IFLNK) {
+            writer.add_symlink(full_path, archive_entry_symlink(entry));
+        }
+        else if (type == AE_IFREG) {
+            PendingFile file = {full_path, mode, std::vector<char>(archive_entry_size(entry))};
+            size_t read = 0;
+            while (read < file.body.size()) {
+                la_ssize_t n = archive_read_data(a, file.body.data() + read, file.body.size() - read);
+                if (n < 0) throw std::runtime_error("Failed to read " + name + ": " + archive_error_string(a));
+                if (n == 0) break;
+                read += n;
+            }
+            file.body.resize(read);
+            writer.add_file(std::move(file));
+        } 
+    }
+    writer.finish();
+}
+
+void extract_tar(const std::string& tar_path, const std::string& output_dir) 
+{
+    struct archive* a = archive_read_new();
+    archive_read_support_format_tar(a);
+    archive_read_support_filter_all(a); // In case it's compressed
+    if (archive_read_open_filename(a, tar_path.c_str(), 10240) != ARCHIVE_OK) {
+        throw std::runtime_error("Failed to open tar file: " + tar_path);
+    }
+    extract_entries(a, output_dir, "");
+    archive_read_free(a);
+}
+
+static la_ssize_t frame_reader_read(struct archive* a, void* client_data, const void** out)
+{
+    ParallelFrameReader* reader = static_cast<ParallelFrameReader*>(client_data);
+    size_t size = 0;
+    try {
+        if (!reader->next(out, &size)) return 0;
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << endl;
+        return ARCHIVE_FATAL;
+    }
+    return size;
+}
+
+static void extract_frames(ParallelFrameReader& reader, const std::string& output_dir, const std::unordered_set<std::string>& only)
+{
+    struct archive* a = archive_read_new();
+    archive_read_support_format_tar(a);
+    if (archive_read_open(a, &reader, nullptr, frame_reader_read, nullptr) != ARCHIVE_OK) {
+        std::string error = archive_error_string(a);
+        archive_read_free(a);
+        throw std::runtime_error("Failed to open embedded archive: " + error);
+    }
+    try {
+        extract_entries(a, output_dir, LANGUAGES_PREFIX, only);
+    }
+    catch (...) {
+        archive_read_free(a);
+        throw;
+    }
+    archive_read_free(a);
+}
+
+const SeekableArchive* embedded_pack()
+{
+    static const std::optional<SeekableArchive> pack = SeekableArchive::open(
+        _binary__languages_tar_zst_start, _binary__languages_tar_zst_end - _binary__languages_tar_zst_start);
+    return pack ? &*pack : nullptr;
+}
+
+// Unpacks one runtime component, or all of them when `component` is empty,
+// into `output_dir` (paths in the pack are relative to .languages/). A
+// non-empty `only` restricts extraction to those paths.
+// Packs built by tools/langpack carry a seek table, so their frames inflate
+// in parallel; anything else is streamed through a single ZSTD_DStream and
+// always extracts in full.
+void extract_embedded_archive(const std::string& output_dir, const std::string& component, const std::unordered_set<std::string>& only)
+{
+    size_t archive_size = _binary__languages_tar_zst_end - _binary__languages_tar_zst_start;
+    const SeekableArchive* seekable = embedded_pack();
+    if (seekable) {
+        ThreadPool pool;
+        if (seekable->components().empty()) {
+            ParallelFrameReader reader(*seekable, pool);
+            extract_frames(reader, output_dir, only);
+            return;
+        }
+        for (const PackComponent& packed : seekable->components()) {
+            if (!component.empty() && packed.name != component) continue;
+            ParallelFrameReader reader(*seekable, pool, packed);
+            extract_frames(reader, output_dir, only);
+        }
+        return;
+    }
+    ZstdMemorySource source = {
+        ZSTD_createDStream(),
+        { _binary__languages_tar_zst_start, archive_size, 0 },
+        std::vector<char>(1 << 20),
+        1
+    };
+    if (!source.stream) {
+        std::cerr << "Failed to create ZSTD_DStream." << endl;
+        exit(1);
+    }
+    ZSTD_initDStream(source.stream);
+    struct archive* a = archive_read_new();
+    archive_read_support_format_tar(a);
+    if (archive_read_open(a, &source, nullptr, zstd_memory_read, nullptr) != ARCHIVE_OK) {
+        std::string error = archive_error_string(a);
+        archive_read_free(a);
+        ZSTD_freeDStream(source.stream);
+        throw std::runtime_error("Failed to open embedded archive: " + error);
+    }
+    extract_entries(a, output_dir, LANGUAGES_PREFIX, only);
+    archive_read_free(a);
+    ZSTD_freeDStream(source.stream);
+}
+
+std::vector<std::string> runtime_components(const std::string& filetype)
+{
+    std::vector<std::string> components = {"jvm-runtime-standard"};
+    for (const std::string& language : filetype_languages(filetype)) {
+        if (language == ".scala") components.push_back("scala-compiler-jars");
+        else if (language == ".kt") components.push_back("kotlin-compiler");
+    }
+    return components;
+}
+
+uint64_t embedded_archive_hash()
+{
+    const SeekableArchive* seekable = embedded_pack();
+    if (seekable) return seekable->fingerprint();
+    return hash_bytes(_binary__languages_tar_zst_start, _binary__languages_tar_zst_end - _binary__languages_tar_zst_start);
+}
+
+std::filesystem::path runtime_dir()
+{
+    static const std::filesystem::path dir = [] {
+        std::filesystem::path base;
+        const char* home_override = std::getenv("MYJVM_HOME");
+        const char* cache_home = std::getenv("XDG_CACHE_HOME");
+        const char* home = std::getenv("HOME");
+        if (home_override && *home_override) base = home_override;
+        else if (cache_home && *cache_home) base = std::filesystem::path(cache_home) / "myjvm";
+        else if (home && *home) base = std::filesystem::path(home) / ".cache" / "myjvm";
+        else base = std::filesystem::temp_directory_path() / "myjvm";
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(embedded_archive_hash()));
+        return std::filesystem::absolute(base / hex);
+    }();
+    return dir;
+}
+
+std::filesystem::path runtime_path(const std::string& relative)
+{
+    return runtime_dir() / relative;
+}
+
+// Holds an exclusive lock on the store for the lifetime of the object.
+class StoreLock
+{
+private:
+    int m_fd = -1;
+public:
+    explicit StoreLock(const std::filesystem::path& path)
+    {
+        #if OS_UNIX_LIKE_DEFINED
+        m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (m_fd == -1) {
+            perror("Unable to open runtime store lock");
+            exit(1);
+        }
+        while (flock(m_fd, LOCK_EX) == -1) {
+            if (errno != EINTR) {
+                perror("Unable to lock runtime store");
+                exit(1);
+            }
+        }
+        #endif
+    }
+    StoreLock(const StoreLock&) = delete;
+    StoreLock& operator=(const StoreLock&) = delete;
+    ~StoreLock()
+    {
+        #if OS_UNIX_LIKE_DEFINED
+        if (m_fd != -1) close(m_fd);
+        #endif
+    }
+};
+
+// Extracts into a private staging directory and renames the finished
+// component into place, so readers never see a half-written runtime.
+void install_runtime_component(const std::string& component)
+{
+    TraceScope trace("install_runtime_component");
+    trace.arg("component", component);
+    std::filesystem::path store = runtime_dir();
+    std::filesystem::path staging = store / (".tmp-" + component + "-" + std::to_string(getpid()));
+    std::filesystem::remove_all(staging);
+    std::filesystem::create_directories(staging);
+    extract_embedded_archive(staging.string(), component);
+    std::filesystem::path root = staging / component;
+    if (!std::filesystem::exists(root)) {
+        std::filesystem::remove_all(staging);
+        std::cerr << "Runtime component missing from embedded archive: " << component << endl;
+        exit(1);
+    }
+    // Packs without a component index extract everything at once.
+    for (const auto& entry : std::filesystem::directory_iterator(staging)) {
+        std::filesystem::path target = store / entry.path().filename();
+        if (std::filesystem::exists(target)) continue;
+        std::filesystem::rename(entry.path(), target);
+    }
+    std::filesystem::remove_all(staging);
+    record_component(component);
+}
+
+// Re-extracts `paths` (store-relative, as reported by verify_component) over
+// the installed component and reports whether it now verifies clean.
+bool repair_runtime_component(const std::string& component, const std::vector<std::string>& paths)
+{
+    TraceScope trace("repair_runtime_component");
+    trace.arg("component", component);
+    std::filesystem::path store = runtime_dir();
+    StoreLock lock(store / ".lock");
+    std::unordered_set<std::string> only;
+    for (const std::string& path : paths) {
+        // Replaced files are recreated so they pick up their archived mode.
+        std::error_code ec;
+        if (!std::filesystem::is_directory(std::filesystem::symlink_status(store / path, ec))) {
+            std::filesystem::remove(store / path, ec);
+        }
+        only.insert(path);
+    }
+    extract_embedded_archive(store.string(), component, only);
+    return verify_component(component, false).damaged.empty();
+}
+
+// Merges installed jars into <store>/layers/<name>.jar the first time it is
+// asked for; every later build copies the layer's entries without unpacking.
+std::filesystem::path runtime_layer(const std::string& name, const std::vector<std::string>& jars)
+{
+    std::filesystem::path store = runtime_dir();
+    std::filesystem::path layer = store / "layers" / (name + ".jar");
+    if (std::filesystem::exists(layer)) return layer;
+    StoreLock lock(store / ".lock");
+    if (std::filesystem::exists(layer)) return layer;
+    TraceScope trace("runtime_layer");
+    trace.arg("layer", name);
+    std::filesystem::create_directories(layer.parent_path());
+    std::vector<std::filesystem::path> sources;
+    for (const std::string& jar : jars) sources.push_back(store / jar);
+    if (!merge_jars(layer, sources)) {
+        std::cerr << "Unable to build the " << name << " runtime layer." << endl;
+        exit(1);
+    }
+    return layer;
+}
+
+// A runtime linked from the bundled JDK with only `modules`, kept under
+// images/ in the store and named after the module set, so every project
+// needing the same modules shares it. nullopt if the JDK cannot link one.
+std::optional<std::filesystem::path> runtime_image(const std::vector<std::string>& modules)
+{
+    std::string list;
+    for (const std::string& module : modules) list += (list.empty() ? "" : ",") + module;
+    char name[20];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash_bytes(list.data(), list.size())));
+    std::filesystem::path store = runtime_dir();
+    std::filesystem::path image = store / "images" / name;
+    if (std::filesystem::exists(image / "bin" / "java")) return image;
+    std::filesystem::path jlink = store / "jvm-runtime-standard" / "bin" / "jlink";
+    if (!std::filesystem::exists(jlink)) return std::nullopt;
+    StoreLock lock(store / ".lock");
+    if (std::filesystem::exists(image / "bin" / "java")) return image;
+    TraceScope trace("runtime_image");
+    trace.arg("modules", list);
+    cout << "Linking a runtime image with " << list << "..." << endl;
+    std::filesystem::path staging = image;
+    staging += ".tmp-" + std::to_string(getpid());
+    std::filesystem::remove_all(staging);
+    std::filesystem::create_directories(image.parent_path());
+    // The image gets its own default CDS archive, which AppCDS archives are
+    // layered on; JDKs older than 17 cannot generate one, so retry without.
+    std::vector<std::string> command = {
+        jlink.string(), "--add-modules", list, "--output", staging.string(),
+        "--strip-debug", "--no-header-files", "--no-man-pages", "--generate-cds-archive"
+    };
+    std::pair<int, std::string> res = OS::run_command(command);
+    if (res.first != 0) {
+        std::filesystem::remove_all(staging);
+        command.pop_back();
+        res = OS::run_command(command);
+    }
+    if (res.first != 0) {
+        std::filesystem::remove_all(staging);
+        std::cerr << "Unable to link a runtime image: " << res.second << endl;
+        return std::nullopt;
+    }
+    // A partial image left by an older or interrupted run would make the
+    // rename fail; it was not usable anyway.
+    std::error_code ec;
+    std::filesystem::remove_all(image, ec);
+    if (!ec) std::filesystem::rename(staging, image, ec);
+    if (ec) {
+        std::cerr << "Unable to store the runtime image " << image << ": " << ec.message() << endl;
+        std::filesystem::remove_all(staging, ec);
+        return std::nullopt;
+    }
+    return image;
+}
+
+// Extracts only the components that are not already in the store, so a
+// Java project never pays for the Scala or Kotlin toolchains, then checks
+// the rest against their integrity records. Returns the components it
+// installed.
+std::vector<std::string> ensure_runtime(const std::vector<std::string>& components)
+{
+    TraceScope trace("ensure_runtime");
+    std::vector<std::string> installed;
+    std::filesystem::path store = runtime_dir();
+    auto missing = [&] {
+        return std::any_of(components.begin(), components.end(), [&](const std::string& component) {
+            return !std::filesystem::exists(store / component);
+        });
+    };
+    if (missing()) {
+        std::filesystem::create_directories(store);
+        StoreLock lock(store / ".lock");
+        for (const std::string& component : components) {
+            // Another process may have installed it while we waited for the lock.
+            if (std::filesystem::exists(store / component)) continue;
+            cout << "Generating " << component << " runtime..." << endl;
+            install_runtime_component(component);
+            installed.push_back(component);
+            cout << "Runtime generated successfully!" << endl;
+        }
+    }
+    for (const std::string& component : components) {
+        IntegrityReport report = verify_component(component, false);
+        if (report.damaged.empty()) continue;
+        cout << "Repairing " << report.damaged.size() << " damaged entries in " << component << "..." << endl;
+        if (!repair_runtime_component(component, report.damaged)) {
+            std::cerr << "Unable to repair " << component << "; remove " << (store / component).string() << " to reinstall it." << endl;
+            exit(1);
+        }
+    }
+    return installed;
+}
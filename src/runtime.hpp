@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "langpack.hpp"
+
+// Bundled runtimes live in a per-user store shared by every project on the
+// host: $XDG_CACHE_HOME/myjvm/<archive-hash>/<component>/ (or $MYJVM_HOME in
+// place of $XDG_CACHE_HOME/myjvm). Components are installed atomically and
+// concurrent invocations wait on a lock instead of extracting twice.
+// Installed components are checked against the pack's entry manifest on
+// every run and damaged entries are re-extracted in place.
+
+inline const std::string LANGUAGES_PREFIX = ".languages/";
+
+std::filesystem::path runtime_dir();
+std::filesystem::path runtime_path(const std::string& relative);
+const SeekableArchive* embedded_pack();  // null for packs without a seek table
+uint64_t embedded_archive_hash();
+void extract_tar(const std::string& tar_path, const std::string& dest_dir);
+void extract_embedded_archive(const std::string& output_dir, const std::string& component = "", 
+                              const std::unordered_set<std::string>& only = {});
+void install_runtime_component(const std::string& component);
+std::filesystem::path runtime_layer(const std::string& name, const std::vector<std::string>& jars);
+std::optional<std::filesystem::path> runtime_image(const std::vector<std::string>& modules);
+bool repair_runtime_component(const std::string& component, const std::vector<std::string>& paths);
+std::vector<std::string> runtime_components(const std::string& filetype);
+std::vector<std::string> ensure_runtime(const std::vector<std::string>& components);
@@ -0,0 +1,594 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include "manifest.hpp"
+#include "os.hpp"
+#include "prewarm.hpp"
+#include "runtime.hpp"
+#include "scheduler.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include "utils.hpp"
+
+using std::cout;
+using std::endl;
+
+// Batches of independent units are not split below this many files; a
+// compiler launch costs more than compiling a handful of sources.
+static const size_t MIN_BATCH_FILES = 32;
+
+static const std::unordered_set<std::string> DECLARATION_KEYWORDS = {
+    "class", "interface", "enum", "record", "object", "trait",
+    "fun", "val", "var", "def", "type", "typealias", "given"
+};
+
+struct Token
+{
+    std::string text;  // an identifier chain like "a.b.C", or empty for punctuation
+    char punct = 0;
+};
+
+// What a source declares and mentions, read from its tokens alone. Only
+// declarations outside any braces count, which is every top-level type and
+// function, plus (for brace-less Scala) some members; an extra name only
+// costs an extra edge.
+struct SourceFacts
+{
+    std::string package;
+    std::vector<std::string> declared;
+    std::vector<std::pair<std::string, std::string>> imports;  // local name, qualified name
+    std::vector<std::string> wildcards;  // "a.b" for "import a.b.*"
+    std::unordered_set<std::string> references;
+};
+
+size_t compile_workers()
+{
+    const char* jobs = std::getenv("MYJVM_JOBS");
+    if (jobs && std::atoi(jobs) > 0) return std::atoi(jobs);
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+static std::string source_language(const std::string& path)
+{
+    std::string ext = std::filesystem::path(path).extension().string();
+    if (ext == ".java" || ext == ".kt" || ext == ".scala") return ext;
+    return "";
+}
+
+static bool is_identifier_start(char c)
+{
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+static bool is_identifier_char(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+// Reads an identifier or a `quoted` one at `i`, advancing past it.
+static std::string read_identifier(std::string_view s, size_t& i)
+{
+    if (s[i] == '`') {
+        size_t end = s.find('`', i + 1);
+        if (end == std::string_view::npos) end = s.size();
+        std::string name(s.substr(i + 1, end - i - 1));
+        i = std::min(end + 1, s.size());
+        return name;
+    }
+    size_t start = i;
+    while (i < s.size() && is_identifier_char(s[i])) i++;
+    return std::string(s.substr(start, i - start));
+}
+
+// Identifier chains and punctuation, with comments, string and character
+// literals and numbers dropped. A chain ending in ".*" is a wildcard, and one
+// ending in "." is followed by an import selector's "{".
+static std::vector<Token> tokenize(std::string_view s)
+{
+    std::vector<Token> tokens;
+    size_t n = s.size();
+    size_t i = 0;
+    while (i < n) {
+        char c = s[i];
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        }
+        else if (s.substr(i, 2) == "//") {
+            size_t end = s.find('\n', i);
+            i = end == std::string_view::npos ? n : end + 1;
+        }
+        else if (s.substr(i, 2) == "/*") {
+            size_t end = s.find("*/", i + 2);
+            i = end == std::string_view::npos ? n : end + 2;
+        }
+        else if (s.substr(i, 3) == "\"\"\"") {
+            size_t end = s.find("\"\"\"", i + 3);
+            i = end == std::string_view::npos ? n : end + 3;
+            while (i < n && s[i] == '"') i++;
+        }
+        else if (c == '"') {
+            for (i++; i < n && s[i] != '"' && s[i] != '\n'; i++) {
+                if (s[i] == '\\') i++;
+            }
+            i++;
+        }
+        else if (c == '\'') {
+            // 'x' and '\n'; a lone quote (a Scala symbol) is skipped by itself.
+            if (i + 1 < n && s[i + 1] == '\\') {
+                size_t end = s.find('\'', i + 3);
+                i = end == std::string_view::npos ? n : end + 1;
+            }
+            else if (i + 2 < n && s[i + 2] == '\'') i += 3;
+            else i++;
+        }
+        else if (std::isdigit(static_cast<unsigned char>(c))) {
+            while (i < n && (is_identifier_char(s[i]) || s[i] == '.')) i++;
+        }
+        else if (is_identifier_start(c) || c == '`') {
+            std::string chain = read_identifier(s, i);
+            while (i + 1 < n && s[i] == '.') {
+                char next = s[i + 1];
+                if (is_identifier_start(next) || next == '`') {
+                    i++;
+                    chain += "." + read_identifier(s, i);
+                }
+                else if (next == '*') {
+                    chain += ".*";
+                    i += 2;
+                    break;
+                }
+                else if (next == '{') {
+                    chain += ".";
+                    i++;
+                    break;
+                }
+                else break;
+            }
+            tokens.push_back({std::move(chain), 0});
+        }
+        else {
+            tokens.push_back({"", c});
+            i++;
+        }
+    }
+    return tokens;
+}
+
+static std::string last_component(const std::string& chain)
+{
+    size_t dot = chain.rfind('.');
+    return dot == std::string::npos ? chain : chain.substr(dot + 1);
+}
+
+static bool is_wildcard(const std::string& name)
+{
+    return name == "*" || name == "_" || name == "given";
+}
+
+// Parses the import starting at token `t`, returning the last token it used.
+static size_t parse_import(const std::vector<Token>& tokens, size_t t, SourceFacts& facts)
+{
+    if (t < tokens.size() && tokens[t].text == "static") t++;
+    if (t >= tokens.size() || tokens[t].text.empty()) return t - 1;
+    std::string path = tokens[t].text;
+    if (path.ends_with(".") && t + 1 < tokens.size() && tokens[t + 1].punct == '{') {
+        // Scala's import a.b.{C, D => E, _}
+        bool renaming = false;
+        for (t += 2; t < tokens.size() && tokens[t].punct != '}'; t++) {
+            const Token& token = tokens[t];
+            if (token.punct == '*') facts.wildcards.push_back(path.substr(0, path.size() - 1));
+            else if (token.punct == '>' || token.text == "as") renaming = true;
+            if (token.text.empty() || token.text == "as") continue;
+            if (renaming && !facts.imports.empty()) facts.imports.back().first = token.text;
+            else if (is_wildcard(token.text)) facts.wildcards.push_back(path.substr(0, path.size() - 1));
+            else facts.imports.push_back({token.text, path + token.text});
+            renaming = false;
+        }
+        return t;
+    }
+    std::string name = last_component(path);
+    if (is_wildcard(name)) {
+        facts.wildcards.push_back(path.substr(0, path.size() - name.size() - 1));
+        return t;
+    }
+    facts.imports.push_back({name, path});
+    if (t + 2 < tokens.size() && tokens[t + 1].text == "as" && !tokens[t + 2].text.empty()) {
+        facts.imports.back().first = tokens[t + 2].text;
+        t += 2;
+    }
+    return t;
+}
+
+static SourceFacts scan_source(const std::string& path)
+{
+    SourceFacts facts;
+    MappedFile file(path);
+    if (!file.ok()) return facts;
+    std::vector<Token> tokens = tokenize(std::string_view(reinterpret_cast<const char*>(file.data()), file.size()));
+    if (source_language(path) == ".kt") {
+        // Java sees a Kotlin file's top-level functions through its FooKt class.
+        std::string facade = std::filesystem::path(path).stem().string();
+        if (!facade.empty()) facade[0] = std::toupper(static_cast<unsigned char>(facade[0]));
+        facts.declared.push_back(facade + "Kt");
+    }
+    int depth = 0;
+    for (size_t t = 0; t < tokens.size(); t++) {
+        const Token& token = tokens[t];
+        if (token.text.empty()) {
+            if (token.punct == '{') depth++;
+            else if (token.punct == '}') depth--;
+            continue;
+        }
+        if (token.text == "package") {
+            if (t + 1 < tokens.size() && !tokens[t + 1].text.empty() && tokens[t + 1].text != "object") {
+                if (!facts.package.empty()) facts.package += ".";
+                facts.package += tokens[++t].text;
+            }
+        }
+        else if (token.text == "import") {
+            t = parse_import(tokens, t + 1, facts);
+        }
+        else if (DECLARATION_KEYWORDS.count(token.text)) {
+            if (depth != 0) continue;
+            size_t next = t + 1;
+            if (next < tokens.size() && tokens[next].punct == '<') {
+                // fun <T> name(...)
+                int angle = 0;
+                for (; next < tokens.size(); next++) {
+                    if (tokens[next].punct == '<') angle++;
+                    else if (tokens[next].punct == '>' && --angle == 0) break;
+                }
+                next++;
+            }
+            if (next >= tokens.size() || tokens[next].text.empty()) continue;
+            std::string name = last_component(tokens[next].text);
+            if (!DECLARATION_KEYWORDS.count(name)) facts.declared.push_back(name);
+        }
+        else {
+            facts.references.insert(token.text);
+        }
+    }
+    return facts;
+}
+
+static std::vector<SourceFacts> scan_sources(const std::vector<std::string>& files, size_t workers)
+{
+    TraceScope trace("scan_dependencies");
+    trace.arg("files", files.size());
+    std::vector<SourceFacts> facts(files.size());
+    ThreadPool pool(std::min(workers, std::max<size_t>(1, files.size() / 64)));
+    std::vector<std::future<void>> pending;
+    size_t chunk = (files.size() + pool.size() - 1) / pool.size();
+    for (size_t start = 0; start < files.size(); start += chunk) {
+        pending.push_back(pool.submit([&, start] {
+            for (size_t i = start; i < std::min(start + chunk, files.size()); i++) facts[i] = scan_source(files[i]);
+        }));
+    }
+    for (std::future<void>& done : pending) done.get();
+    return facts;
+}
+
+static std::string qualify(const std::string& package, const std::string& name)
+{
+    return package.empty() ? name : package + "." + name;
+}
+
+// Tarjan's algorithm. Components come out dependencies first.
+class ComponentFinder
+{
+private:
+    // Fields
+    const std::vector<std::set<size_t>>& m_edges;
+    std::vector<int> m_index;
+    std::vector<int> m_low;
+    std::vector<bool> m_on_stack;
+    std::vector<size_t> m_stack;
+    std::vector<std::vector<size_t>> m_components;
+    int m_next = 0;
+
+    void visit(size_t v)
+    {
+        m_index[v] = m_low[v] = m_next++;
+        m_stack.push_back(v);
+        m_on_stack[v] = true;
+        for (size_t w : m_edges[v]) {
+            if (m_index[w] < 0) {
+                visit(w);
+                m_low[v] = std::min(m_low[v], m_low[w]);
+            }
+            else if (m_on_stack[w]) m_low[v] = std::min(m_low[v], m_index[w]);
+        }
+        if (m_low[v] != m_index[v]) return;
+        std::vector<size_t> component;
+        size_t w;
+        do {
+            w = m_stack.back();
+            m_stack.pop_back();
+            m_on_stack[w] = false;
+            component.push_back(w);
+        } while (w != v);
+        m_components.push_back(std::move(component));
+    }
+public:
+    // Constructor
+    explicit ComponentFinder(const std::vector<std::set<size_t>>& edges)
+        : m_edges(edges), m_index(edges.size(), -1), m_low(edges.size()), m_on_stack(edges.size())
+    {
+        for (size_t v = 0; v < edges.size(); v++) {
+            if (m_index[v] < 0) visit(v);
+        }
+    }
+
+    // Methods
+    inline const std::vector<std::vector<size_t>>& components() const { return m_components; }
+};
+
+// Splits `units` (all at one depth, so independent) into at most `workers`
+// batches of at least MIN_BATCH_FILES, balanced by file count.
+static std::vector<std::vector<size_t>> batch_units(std::vector<size_t> units, const std::vector<CompileUnit>& all, size_t workers)
+{
+    size_t files = 0;
+    for (size_t u : units) files += all[u].sources.size();
+    size_t count = std::clamp<size_t>(files / MIN_BATCH_FILES, 1, std::min(workers, units.size()));
+    std::sort(units.begin(), units.end(), [&](size_t a, size_t b) {
+        if (all[a].sources.size() != all[b].sources.size()) return all[a].sources.size() > all[b].sources.size();
+        return a < b;
+    });
+    std::vector<std::vector<size_t>> batches(count);
+    std::vector<size_t> sizes(count);
+    for (size_t u : units) {
+        size_t smallest = std::min_element(sizes.begin(), sizes.end()) - sizes.begin();
+        batches[smallest].push_back(u);
+        sizes[smallest] += all[u].sources.size();
+    }
+    return batches;
+}
+
+static CompileUnit merge_units(const std::vector<size_t>& members, const std::vector<CompileUnit>& all)
+{
+    CompileUnit merged;
+    std::vector<size_t> sorted = members;
+    std::sort(sorted.begin(), sorted.end());
+    merged.name = all[sorted[0]].name;
+    if (sorted.size() > 1) merged.name += " (+" + std::to_string(sorted.size() - 1) + " more)";
+    for (size_t u : sorted) {
+        merged.sources.insert(merged.sources.end(), all[u].sources.begin(), all[u].sources.end());
+        merged.languages.insert(all[u].languages.begin(), all[u].languages.end());
+    }
+    return merged;
+}
+
+// With a single worker nothing runs side by side, so each language is one
+// unit and only languages that depend on each other are split into steps.
+std::vector<CompileUnit> plan_compile_units(const std::vector<std::string>& files, size_t workers)
+{
+    TraceScope trace("plan_units");
+    std::vector<CompileUnit> units;
+    std::vector<size_t> unit_of(files.size());
+    std::map<std::string, size_t> by_key;
+    for (size_t i = 0; i < files.size(); i++) {
+        std::string language = source_language(files[i]);
+        std::string directory = std::filesystem::path(files[i]).parent_path().generic_string();
+        if (directory.empty()) directory = ".";
+        std::string key = workers > 1 ? directory + "\n" + language : language;
+        auto [it, inserted] = by_key.try_emplace(key, units.size());
+        if (inserted) {
+            CompileUnit unit;
+            unit.name = workers > 1 ? directory + " (" + language + ")" : language.substr(1) + " sources";
+            unit.languages = {language};
+            units.push_back(std::move(unit));
+        }
+        units[it->second].sources.push_back(files[i]);
+        unit_of[i] = it->second;
+    }
+    if (units.size() <= 1) return units;
+
+    std::vector<SourceFacts> facts = scan_sources(files, workers);
+    std::unordered_map<std::string, std::vector<size_t>> owners;
+    for (size_t i = 0; i < files.size(); i++) {
+        for (const std::string& name : facts[i].declared) owners[qualify(facts[i].package, name)].push_back(unit_of[i]);
+    }
+    std::vector<std::set<size_t>> edges(units.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        const SourceFacts& source = facts[i];
+        size_t unit = unit_of[i];
+        auto link = [&](const std::string& qualified) {
+            auto it = owners.find(qualified);
+            if (it == owners.end()) return;
+            for (size_t owner : it->second) {
+                if (owner != unit) edges[unit].insert(owner);
+            }
+        };
+        // Qualified names: every prefix of "a.b.C.m" with a dot in it.
+        auto link_prefixes = [&](const std::string& chain) {
+            size_t dot = chain.find('.');
+            if (dot == std::string::npos) return;
+            do {
+                dot = chain.find('.', dot + 1);
+                link(chain.substr(0, dot));
+            } while (dot != std::string::npos);
+        };
+        for (const auto& [name, qualified] : source.imports) link_prefixes(qualified);
+        // `import static a.b.C.*` and `import a.b.C._` depend on C itself.
+        for (const std::string& wildcard : source.wildcards) {
+            link(wildcard);
+            link_prefixes(wildcard);
+        }
+        for (const std::string& reference : source.references) {
+            link_prefixes(reference);
+            std::string first = reference.substr(0, reference.find('.'));
+            link(qualify(source.package, first));
+            for (const std::string& wildcard : source.wildcards) link(qualify(wildcard, first));
+        }
+    }
+
+    ComponentFinder finder(edges);
+    const std::vector<std::vector<size_t>>& components = finder.components();
+    trace.arg("units", units.size());
+    trace.arg("cycles", units.size() - components.size());
+    std::vector<CompileUnit> merged;
+    std::vector<size_t> component_of(units.size());
+    std::vector<size_t> depth(components.size());
+    for (size_t c = 0; c < components.size(); c++) {
+        for (size_t u : components[c]) component_of[u] = c;
+        merged.push_back(merge_units(components[c], units));
+        for (size_t u : components[c]) {
+            for (size_t dependency : edges[u]) {
+                size_t d = component_of[dependency];
+                if (d != c) depth[c] = std::max(depth[c], depth[d] + 1);
+            }
+        }
+    }
+
+    // Units at the same depth cannot depend on each other.
+    std::map<std::pair<size_t, std::set<std::string>>, std::vector<size_t>> levels;
+    for (size_t c = 0; c < merged.size(); c++) levels[{depth[c], merged[c].languages}].push_back(c);
+    std::vector<CompileUnit> result;
+    std::vector<size_t> result_of(merged.size());
+    for (const auto& [level, members] : levels) {
+        for (const std::vector<size_t>& batch : batch_units(members, merged, workers)) {
+            CompileUnit unit = merge_units(batch, merged);
+            std::set<size_t> dependencies;
+            for (size_t c : batch) {
+                result_of[c] = result.size();
+                for (size_t u : components[c]) {
+                    for (size_t dependency : edges[u]) {
+                        size_t d = component_of[dependency];
+                        if (d != c) dependencies.insert(result_of[d]);
+                    }
+                }
+            }
+            unit.dependencies.assign(dependencies.begin(), dependencies.end());
+            result.push_back(std::move(unit));
+        }
+    }
+    trace.arg("batches", result.size());
+    return result;
+}
+
+// A daemon answers one request at a time; units compiling alongside the one
+// using it launch their own compiler rather than queue behind it.
+struct DaemonSlots
+{
+    std::atomic<bool> java{false};
+    std::atomic<bool> scala{false};
+    std::atomic<bool> kotlin{false};
+};
+
+static bool run_unit_compiler(const std::string& language, const std::vector<std::string>& args,
+                              const CompileUnit& unit, DaemonSlots& daemons)
+{
+    std::atomic<bool>& slot = language == "java" ? daemons.java : (language == "scala" ? daemons.scala : daemons.kotlin);
+    bool claimed = !slot.exchange(true);
+    std::pair<int, std::string> res = run_compiler(language, compiler_launcher(language, compiler_jvm_options(language)), args, claimed);
+    if (claimed) slot = false;
+    if (res.first == 0) return true;
+    std::cerr << "Compilation failed in " + unit.name + ": " + res.second + "\n";
+    return false;
+}
+
+// Scala and Kotlin units that include Java sources hand them to their own
+// compiler for their declarations, then to javac with the result in out/.
+static bool compile_unit(const CompileUnit& unit, const std::string& classpath, DaemonSlots& daemons)
+{
+    TraceScope trace("compile_unit");
+    trace.arg("unit", unit.name);
+    trace.arg("files", unit.sources.size());
+    std::string out = std::filesystem::absolute("out").string();
+    std::vector<std::string> java_sources;
+    std::vector<std::string> other_sources;
+    for (const std::string& file : unit.sources) {
+        std::string path = std::filesystem::absolute(file).string();
+        if (source_language(file) == ".java") java_sources.push_back(path);
+        else other_sources.push_back(path);
+    }
+    bool scala = unit.languages.count(".scala");
+    bool kotlin = unit.languages.count(".kt");
+    if (scala && kotlin) {
+        std::cerr << "Unable to compile " + unit.name + ": its Scala and Kotlin sources depend on each other.\n";
+        return false;
+    }
+    if (scala || kotlin) {
+        std::vector<std::string> args;
+        if (scala) args = {"-classpath", classpath, "-d", out};
+        else {
+            // Module files are per unit so that units do not overwrite each
+            // other's; friend paths keep `internal` visible across units.
+            char module[32];
+            std::snprintf(module, sizeof(module), "myjvm-%016llx", static_cast<unsigned long long>(hash_bytes(unit.name.data(), unit.name.size())));
+            args = {"-cp", classpath, "-d", out, "-module-name", module, "-Xfriend-paths=" + out};
+        }
+        args.insert(args.end(), other_sources.begin(), other_sources.end());
+        args.insert(args.end(), java_sources.begin(), java_sources.end());
+        if (!run_unit_compiler(scala ? "scala" : "kotlin", args, unit, daemons)) return false;
+    }
+    if (java_sources.empty()) return true;
+    std::vector<std::string> args = {"-cp", classpath, "-d", out};
+    args.insert(args.end(), java_sources.begin(), java_sources.end());
+    return run_unit_compiler("java", args, unit, daemons);
+}
+
+// `libraries` are store paths of the standard libraries the project's
+// languages need on the classpath. After a failure no new unit starts, but
+// the ones running are let finish.
+bool compile_units(const std::vector<CompileUnit>& units, const std::vector<std::string>& libraries, size_t workers)
+{
+    std::filesystem::create_directories("out");
+    std::string classpath = std::filesystem::absolute("out").string();
+    for (const std::string& library : libraries) classpath += ":" + runtime_path(library).string();
+    std::vector<std::vector<size_t>> dependents(units.size());
+    std::vector<size_t> waiting(units.size());
+    for (size_t i = 0; i < units.size(); i++) {
+        waiting[i] = units[i].dependencies.size();
+        for (size_t dependency : units[i].dependencies) dependents[dependency].push_back(i);
+    }
+    DaemonSlots daemons;
+    std::mutex mutex;
+    std::condition_variable finished_ready;
+    std::queue<std::pair<size_t, bool>> finished;
+    ThreadPool pool(std::max<size_t>(1, std::min(workers, units.size())));
+    size_t running = 0;
+    auto start = [&](size_t i) {
+        running++;
+        pool.submit([&, i] {
+            bool ok = compile_unit(units[i], classpath, daemons);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.push({i, ok});
+            }
+            finished_ready.notify_one();
+        });
+    };
+    for (size_t i = 0; i < units.size(); i++) {
+        if (waiting[i] == 0) start(i);
+    }
+    bool success = true;
+    while (running > 0) {
+        std::pair<size_t, bool> result;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished_ready.wait(lock, [&] { return !finished.empty(); });
+            result = finished.front();
+            finished.pop();
+        }
+        running--;
+        if (!result.second) success = false;
+        if (!success) continue;
+        for (size_t dependent : dependents[result.first]) {
+            if (--waiting[dependent] == 0) start(dependent);
+        }
+    }
+    return success;
+}
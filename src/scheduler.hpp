@@ -0,0 +1,26 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+// Build scheduling. Sources are split into units by directory and language,
+// and a unit depends on another when its tokens name a type or top-level
+// declaration the other declares, by its package, an import or a qualified
+// name. Units that depend on each other are merged, and independent units
+// at the same depth are batched so that no compiler run is tiny. Each unit
+// compiles as soon as everything it depends on has, with up to
+// compile_workers() compilers running at once, into the shared out/ that is
+// on every later unit's classpath.
+
+struct CompileUnit
+{
+    std::string name;  // the directory it came from, for messages
+    std::vector<std::string> sources;
+    std::set<std::string> languages;  // ".java", ".kt", ".scala"
+    std::vector<size_t> dependencies;  // indices of earlier units
+};
+
+size_t compile_workers();
+std::vector<CompileUnit> plan_compile_units(const std::vector<std::string>& files, size_t workers);
+bool compile_units(const std::vector<CompileUnit>& units, const std::vector<std::string>& libraries, size_t workers);
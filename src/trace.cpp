@@ -0,0 +1,107 @@
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "os.hpp"
+#include "trace.hpp"
+
+using std::endl;
+
+// Completed events. The whole file is rewritten on each flush; whatever came
+// after the last one is written when the process exits normally.
+class TraceLog
+{
+private:
+    // Fields
+    std::mutex m_mutex;
+    std::vector<std::string> m_events;
+    size_t m_flushed = 0;  // events in the file as last written
+public:
+    void add(std::string event)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.push_back(std::move(event));
+    }
+    ~TraceLog()
+    {
+        if (m_events.size() != m_flushed) write();
+    }
+    void write()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string path = std::getenv("MYJVM_TRACE");
+        if (path == "1") path = "myjvm-trace.json";
+        size_t pid_pos = path.find("%p");
+        if (pid_pos != std::string::npos) path.replace(pid_pos, 2, std::to_string(current_pid()));
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Unable to write trace to " << path << endl;
+            return;
+        }
+        file << "{\"traceEvents\": [\n";
+        for (size_t i = 0; i < m_events.size(); i++) file << m_events[i] << (i + 1 < m_events.size() ? ",\n" : "\n");
+        file << "], \"displayTimeUnit\": \"ms\"}\n";
+        m_flushed = m_events.size();
+    }
+    static int64_t current_pid()
+    {
+        #if OS_UNIX_LIKE_DEFINED
+        return getpid();
+        #else
+        return 0;
+        #endif
+    }
+};
+
+static TraceLog& trace_log()
+{
+    static TraceLog log;
+    return log;
+}
+
+void trace_flush()
+{
+    if (trace_enabled()) trace_log().write();
+}
+
+int64_t trace_now()
+{
+    static const auto origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+static std::string json_string(const std::string& text)
+{
+    std::string out = "\"";
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') out += '\\';
+        if (static_cast<unsigned char>(ch) < 0x20) out += ' ';
+        else out += ch;
+    }
+    return out + "\"";
+}
+
+void TraceScope::arg(const char* key, const std::string& value)
+{
+    if (m_start >= 0) add_arg(key, json_string(value));
+}
+
+void TraceScope::add_arg(const char* key, const std::string& json)
+{
+    if (!m_args.empty()) m_args += ", ";
+    m_args += json_string(key) + ": " + json;
+}
+
+void TraceScope::record()
+{
+    int64_t end = trace_now();
+    size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id()) % 100000;
+    std::string event = "{\"name\": " + json_string(m_name) + ", \"cat\": \"myjvm\", \"ph\": \"X\", \"ts\": " + std::to_string(m_start) +
+                        ", \"dur\": " + std::to_string(end - m_start) + ", \"pid\": " + std::to_string(TraceLog::current_pid()) +
+                        ", \"tid\": " + std::to_string(thread);
+    if (!m_args.empty()) event += ", \"args\": {" + m_args + "}";
+    trace_log().add(event + "}");
+}
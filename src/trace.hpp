@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+// Phase tracing. With MYJVM_TRACE set to a file name, every TraceScope is
+// recorded as a Chrome trace event and the file is written by trace_flush,
+// which main calls on its way out; open it in Perfetto or chrome://tracing.
+// MYJVM_TRACE=1 writes myjvm-trace.json, and a "%p" in the name is replaced
+// by the process id. When it is unset a scope costs a check of a cached flag.
+
+inline bool trace_enabled()
+{
+    static const bool enabled = [] {
+        const char* path = std::getenv("MYJVM_TRACE");
+        return path && *path && std::string(path) != "0";
+    }();
+    return enabled;
+}
+
+int64_t trace_now();  // microseconds since the first call
+void trace_flush();  // writes every event recorded so far
+
+// Times the enclosing scope. Arguments show up in the event's details.
+class TraceScope
+{
+private:
+    // Fields
+    const char* m_name;
+    int64_t m_start = -1;
+    std::string m_args;  // rendered JSON object members
+
+    void record();
+    void add_arg(const char* key, const std::string& json);
+public:
+    explicit TraceScope(const char* name) : m_name(name)
+    {
+        if (trace_enabled()) m_start = trace_now();
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+    ~TraceScope()
+    {
+        if (m_start >= 0) record();
+    }
+    inline void arg(const char* key, int64_t value)
+    {
+        if (m_start >= 0) add_arg(key, std::to_string(value));
+    }
+    void arg(const char* key, const std::string& value);
+};
@@ -1,68 +1,48 @@
-#include <archive.h>
 #include <algorithm>
-#include <archive_entry.h>
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <set>
 #include <stdexcept>
 #include <string>
-#include <zstd.h> 
+#include "classfile.hpp"
+#include "daemon.hpp"
+#include "jar.hpp"
+#include "manifest.hpp"
 #include "os.hpp"
+#include "prewarm.hpp"
+#include "project.hpp"
+#include "runtime.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
 
 using std::cout;
 using std::endl;
 
-extern const unsigned char _binary__languages_tar_zst_start[];
-extern const unsigned char _binary__languages_tar_zst_end[];
-
 std::string infer_file_type(const std::filesystem::path& root)
 {
-    std::vector<std::string> files;
-    for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
-        if (!entry.is_regular_file()) continue;
-        std::string ext = entry.path().extension();
-        if (ext == ".scala" || ext == ".sc") return ".scala";
-        else if (ext == ".java") return ".java";
-        else if (ext == ".kt") return ".kt";
-    }
-    return "UNKNOWN";
+    return project_index(root).filetype;
 }
 
 std::vector<std::string> find_source_files(const std::filesystem::path& root) 
 {
-    std::vector<std::string> files;
-    std::string filetype = infer_file_type(root);
-    for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
-        if (!entry.is_regular_file()) continue;
-        std::string ext = entry.path().extension();
-        if (my::string(ext).contains(filetype)) {
-            files.emplace_back(entry.path().string());
-        }
-    }
-    return files;
+    return project_index(root).sources;
 }
 
+// Class files come from the index too; compile_files marks them stale, so
+// only out/ is rescanned after a compile.
 std::vector<std::string> get_class_files()
 {
-    std::vector<std::string> result;
-    for (const auto& entry : std::filesystem::recursive_directory_iterator("out")) {
-        if (!entry.is_regular_file()) continue;
-        std::string ext = entry.path().extension();
-        if (ext == ".class") result.emplace_back(entry.path().string());
-    }
-    return result;
+    return project_index().class_files;
 }
 
 std::vector<std::string> get_class_names()
 {
     std::vector<std::string> result;
-    std::filesystem::path out_dir = "out";
-    for (const auto& entry : std::filesystem::recursive_directory_iterator(out_dir)) {
-        if (!entry.is_regular_file()) continue;
-        if (entry.path().extension() != ".class") continue;
-        std::filesystem::path relative_path = std::filesystem::relative(entry.path(), out_dir);
-        std::string without_ext = relative_path.replace_extension("").string();
+    for (const std::string& file : get_class_files()) {
+        std::string without_ext = std::filesystem::path(file).lexically_relative("out").replace_extension("").string();
         for (auto& ch : without_ext) {
             if (ch == '/' || ch == '\\') ch = '.'; 
         }
@@ -71,13 +51,10 @@ std::vector<std::string> get_class_names()
     return result;
 }
 
-void compile_scala_files(const my::vector<std::string>& files)
+std::string scala_compiler_classpath()
 {
-    cout << "Compiling Scala files..." << endl;
-    std::string file_str = files.join(" ");
-    std::filesystem::path cwd = std::filesystem::current_path();
-    std::string prefix = cwd.string() + "/.languages/scala-compiler-jars/";
-    std::string scala_cp = 
+    std::string prefix = runtime_path("scala-compiler-jars/").string();
+    return
         prefix + "scala3-compiler_3-3.3.1.jar:" +
         prefix + "scala3-library_3-3.3.1.jar:" +
         prefix + "scala3-interfaces-3.3.1.jar:" +
@@ -90,355 +67,418 @@ void compile_scala_files(const my::vector<std::string>& files)
         prefix + "jline-terminal-3.19.0.jar:" +
         prefix + "jline-terminal-jna-3.19.0.jar:" +
         prefix + "jna-5.3.1.jar";
-    std::string java_path = cwd.string() + "/.languages/jvm-runtime-standard/bin/java";
-    std::vector<std::string> class_cmd = {
-        java_path,
-        "-Dscala.usejavacp=true",
-        "-cp", scala_cp,
-        "dotty.tools.dotc.Main",
-        "-sourcepath", ".",
-        "-d", "out/"
-    };
-    for (const auto& file : files) class_cmd.push_back(file); 
-    std::pair<int, std::string> res = OS::run_command(class_cmd);
-    if (res.first != 0) {
-        std::cerr << "Compilation failed: " << res.second << endl;
-        return;
-    }
-    std::vector<std::string> class_files = get_class_files();
-    if (!add_scala_runtime(".languages/scala-compiler-jars/scala3-library_3-3.3.1.jar")) {
-        std::cerr << "Unable to add Scala3 runtime." << endl;
-        exit(1);
-    }
-    bool success = create_jar_from_classes(class_files);
-    if (success) cout << "Files compiled successfully!" << endl;
-    else cout << "Unable to archive files to a jar.";
 }
 
-void compile_kotlin_files(const my::vector<std::string>& files)
+// kotlin-compiler.jar names the rest of lib/ in its manifest's Class-Path.
+std::string kotlin_compiler_classpath()
 {
-    cout << "Compiling Kotlin files..." << endl;
-    std::string file_str = files.join(" ");
-    std::string command = ".languages/kotlin-compiler/kotlinc/bin/kotlinc -include-runtime -d out/all_files.jar " + file_str;
-    std::pair<int, std::string> res = OS::run_command(command);
-    if (res.first != 0) {
-        std::cerr << "Compilation failed: " << res.second << endl;
-        return;
-    }
-    cout << "Files compiled successfully!" << endl;
+    return runtime_path("kotlin-compiler/kotlinc/lib/kotlin-compiler.jar").string();
 }
 
-void compile_java_files(const my::vector<std::string>& files)
+// Store paths of the standard libraries programs in `filetype`'s languages
+// need at compile and run time.
+std::vector<std::string> runtime_libraries(const std::string& filetype)
 {
-    cout << "Compiling Java files..." << endl;
-    std::string file_str = files.join(" ");
-    std::string class_cmd = ".languages/jvm-runtime-standard/bin/javac -d out/ " + file_str;
-    std::pair<int, std::string> res = OS::run_command(class_cmd);
-    if (res.first != 0) {
-        cout << "Compilation failed: " << res.second << endl;
-        return;
+    std::vector<std::string> libraries;
+    std::vector<std::string> languages = filetype_languages(filetype);
+    if (std::find(languages.begin(), languages.end(), ".kt") != languages.end()) {
+        libraries.push_back("kotlin-compiler/kotlinc/lib/kotlin-stdlib.jar");
     }
-    std::vector<std::string> class_files = get_class_files();
-    bool success = create_jar_from_classes(class_files);
-    if (success) cout << "Files compiled successfully!" << endl;
-    else cout << "Unable to archive files to a jar.";
+    if (std::find(languages.begin(), languages.end(), ".scala") != languages.end()) {
+        libraries.push_back("scala-compiler-jars/scala3-library_3-3.3.1.jar");
+        libraries.push_back("scala-compiler-jars/scala-library-2.13.12.jar");
+    }
+    return libraries;
 }
 
-std::string run_known_class_file(std::string& name, const std::string& filetype)
+// Those libraries merged once into a jar in the store; project jars copy it
+// in raw instead of carrying an unpacked copy in out/. Empty for Java.
+std::filesystem::path runtime_library_layer(const std::string& filetype)
 {
-    if (filetype == ".java") return run_known_java_class_file(name);
-    else if (filetype == ".kt") return run_kotlin_jar();
-    else if (filetype == ".scala") return run_known_scala_class_file(name);
-    else return "Unknown file type provided.";
+    std::vector<std::string> libraries = runtime_libraries(filetype);
+    if (libraries.empty()) return {};
+    std::string name;
+    for (const std::string& library : libraries) {
+        std::string language = library.starts_with("kotlin") ? "kotlin" : "scala";
+        if (name.find(language) == std::string::npos) name += language + "-";
+    }
+    return runtime_layer(name + "runtime", libraries);
 }
 
-std::string try_run_class_files(std::vector<std::string>& class_names, const std::string& filetype)
+// MYJVM_XMX ("512m") caps the heap of every JVM myjvm starts; `myjvm batch`
+// sets it to each job's share of the memory budget.
+static std::vector<std::string> heap_options()
 {
-    if (filetype == ".java") return try_run_java_class_files(class_names);
-    else if (filetype == ".kt") return run_kotlin_jar();
-    else if (filetype == ".scala") return try_run_scala_class_files(class_names);
-    else return "Unknown file type provided.";
+    const char* xmx = std::getenv("MYJVM_XMX");
+    if (!xmx || !*xmx) return {};
+    return {std::string("-Xmx") + xmx};
 }
 
-std::string run_known_java_class_file(std::string& name)
+// The command that starts `language`'s compiler, before its arguments, with
+// `jvm_options` passed to the JVM it runs in. Kotlin's compiler is started on
+// the JVM directly, the way the kotlinc script would, without the shell.
+std::vector<std::string> compiler_launcher(const std::string& language, const std::vector<std::string>& jvm_options)
 {
-    cout << "Running: '" << name << "'" << endl;
-    std::string command = ".languages/jvm-runtime-standard/bin/java -cp out/all_files.jar " + name;
-    std::pair<int, std::string> res = OS::run_command(command);
-    if (res.first == 0) return res.second;
-    else return "Unable to run provided entrypoint.";
+    std::vector<std::string> options = heap_options();
+    options.insert(options.end(), jvm_options.begin(), jvm_options.end());
+    std::vector<std::string> command;
+    if (language == "scala" || language == "kotlin") {
+        command.push_back(runtime_path("jvm-runtime-standard/bin/java").string());
+        command.insert(command.end(), options.begin(), options.end());
+        if (language == "scala") command.insert(command.end(), {"-Dscala.usejavacp=true", "-cp", scala_compiler_classpath(), "dotty.tools.dotc.Main"});
+        else command.insert(command.end(), {"-Dkotlin.home=" + runtime_path("kotlin-compiler/kotlinc").string(), "-Xss2m",
+                                            "-cp", kotlin_compiler_classpath(), "org.jetbrains.kotlin.cli.jvm.K2JVMCompiler"});
+        return command;
+    }
+    // javac is a launcher of its own and takes JVM options as -J<option>.
+    command.push_back(runtime_path("jvm-runtime-standard/bin/javac").string());
+    for (const std::string& option : options) command.push_back("-J" + option);
+    return command;
 }
 
-std::string try_run_java_class_files(std::vector<std::string>& class_names)
+// Compiles through the warm daemon for `language` when one is listening,
+// `use_daemon` is set and MYJVM_DAEMON is not "0"; otherwise spawns
+// `launcher` with the same arguments.
+// Paths in `args` must be absolute since the daemon does not share our
+// working directory.
+std::pair<int, std::string> run_compiler(const std::string& language, 
+                                         const std::vector<std::string>& launcher, 
+                                         const std::vector<std::string>& args,
+                                         bool use_daemon)
 {
-    cout << "Attempting:" << endl;
-    for (std::string& name : class_names) {
-        if (my::string(name).contains("$") || name.starts_with("scala.")) continue;
-        std::string result = run_known_java_class_file(name);
-        if (result != "Unable to run provided entrypoint.") return result; 
-    }    
-    return "No valid entrypoints detected.";
+    TraceScope trace("compiler");
+    trace.arg("language", language);
+    const char* daemon = std::getenv("MYJVM_DAEMON");
+    std::optional<std::pair<int, std::string>> warm;
+    if (use_daemon && !(daemon && std::string(daemon) == "0")) warm = daemon_compile(language, args);
+    trace.arg("daemon", warm.has_value());
+    if (warm) return *warm;
+    std::vector<std::string> command = launcher;
+    command.insert(command.end(), args.begin(), args.end());
+    return OS::run_command(command);
 }
 
-std::string run_known_scala_class_file(std::string& name)
+// The program's output goes straight to the terminal as it is produced; only
+// the end of its stderr is kept, to explain a failed launch.
+static int run_program(const std::vector<std::string>& command, const std::string& name)
 {
-    cout << "Running: '" << name << "'" << endl;
-    std::string scala_cp = 
-        ".languages/scala-compiler-jars/scala3-compiler_3-3.3.1.jar:"
-        ".languages/scala-compiler-jars/scala3-library_3-3.3.1.jar:"
-        ".languages/scala-compiler-jars/scala3-interfaces-3.3.1.jar:"
-        ".languages/scala-compiler-jars/scala-library-2.13.12.jar:"
-        ".languages/scala-compiler-jars/tasty-core_3-3.3.1.jar:"
-        ".languages/scala-compiler-jars/scala-asm-9.5.0-scala-1.jar:"
-        ".languages/scala-compiler-jars/util-interface-1.3.0.jar:"
-        ".languages/scala-compiler-jars/protobuf-java-3.7.0.jar:"
-        ".languages/scala-compiler-jars/jline-reader-3.19.0.jar:"
-        ".languages/scala-compiler-jars/jline-terminal-3.19.0.jar:"
-        ".languages/scala-compiler-jars/jline-terminal-jna-3.19.0.jar:"
-        ".languages/scala-compiler-jars/jna-5.3.1.jar";
-    std::string command = 
-        ".languages/jvm-runtime-standard/bin/java "
-        "-Dscala.usejavacp=true "
-        "-cp out/all_files.jar:" + scala_cp + " " + name;
-    std::pair<int, std::string> res = OS::run_command(command);
-    if (res.first == 0) return res.second;
-    else return "Unable to run provided Scala entrypoint.";
+    TraceScope trace("run");
+    trace.arg("program", name);
+    OutputTail tail;
+    int status = OS::run_command_streaming(command, &tail);
+    if (status == 0) return 0;
+    std::cerr << "'" << name << "' exited with status " << status << "." << endl;
+    if (tail.str().find("Could not find or load main class") != std::string::npos) {
+        std::cerr << "Pass the fully qualified class name, e.g. example.Main." << endl;
+    }
+    return status;
 }
 
-std::string try_run_scala_class_files(std::vector<std::string>& class_names)
+// The modules `jar` uses according to jdeps, java.base included, sorted.
+// They are kept in MODULES_PATH under the jar's `key` until the jar changes.
+// Empty if jdeps is missing or fails.
+static std::vector<std::string> jar_modules(const std::filesystem::path& jar, const std::string& key)
 {
-    cout << "Attempting:" << endl;
-    for (std::string& name : class_names) {
-        if (my::string(name).contains("$") || name.starts_with("scala.")) continue;
-        std::string result = run_known_scala_class_file(name);
-        if (result != "Unable to run provided Scala entrypoint.") {
-            return result;
+    std::ifstream cached(MODULES_PATH);
+    std::string cached_key;
+    std::string list;
+    if (cached >> cached_key >> list && cached_key == key) return split(list, ',');
+    std::filesystem::path jdeps = runtime_path("jvm-runtime-standard/bin/jdeps");
+    if (!std::filesystem::exists(jdeps)) return {};
+    TraceScope trace("jdeps");
+    std::pair<int, std::string> res = OS::run_command({
+        jdeps.string(), "--print-module-deps", "--ignore-missing-deps", "--multi-release", "base", jar.string()
+    });
+    if (res.first != 0) {
+        std::cerr << "jdeps could not analyse " << jar.string() << ": " << res.second << endl;
+        return {};
+    }
+    // The module list is the last line; anything before it is a warning.
+    std::set<std::string> modules = {"java.base"};
+    std::vector<std::string> lines = split(res.second, '\n');
+    while (!lines.empty() && lines.back().find_first_not_of(" \r\t") == std::string::npos) lines.pop_back();
+    if (!lines.empty()) {
+        for (std::string module : split(lines.back(), ',')) {
+            module.erase(std::remove_if(module.begin(), module.end(), ::isspace), module.end());
+            if (!module.empty()) modules.insert(module);
         }
     }
-    return "No valid Scala entrypoints detected.";
+    std::vector<std::string> result(modules.begin(), modules.end());
+    list.clear();
+    for (const std::string& module : result) list += (list.empty() ? "" : ",") + module;
+    std::ofstream(MODULES_PATH) << key << ' ' << list << '\n';
+    trace.arg("modules", list);
+    return result;
 }
 
-std::string run_kotlin_jar()
+// MYJVM_JLINK=1 runs programs on a runtime image holding only the modules
+// their jar uses. Modules loaded only by reflection are not seen by jdeps,
+// hence opt-in.
+static std::optional<std::filesystem::path> program_image(const std::filesystem::path& jar, const std::string& key)
 {
-    cout << "Running Kotlin project." << endl;;
-    std::string java_path = ".languages/jvm-runtime-standard/bin/java";
-    std::string command = java_path + " -jar out/all_files.jar";
-    std::pair<int, std::string> res = OS::run_command(command);
-    if (res.first == 0) return res.second;
-    else return "Unable to run Kotlin jar.";
+    const char* jlink = std::getenv("MYJVM_JLINK");
+    if (!jlink || !*jlink || std::string(jlink) == "0") return std::nullopt;
+    std::vector<std::string> modules = jar_modules(jar, key);
+    if (modules.empty()) return std::nullopt;
+    std::optional<std::filesystem::path> image = runtime_image(modules);
+    if (!image) std::cerr << "No runtime image could be linked; running on the full runtime." << endl;
+    return image;
 }
 
-bool already_compiled(const std::filesystem::path& root)
+// Archives dumped for earlier builds of the jar. Those for `key` on another
+// runtime stay, and so do other runs' unfinished .tmp dumps.
+static void remove_stale_archives(const std::string& key)
 {
-    std::filesystem::path output = root / "out" / "all_files.jar";
-    if (std::filesystem::exists(output)) return true;
-    return false;
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(CDS_DIR, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        std::error_code remove_ec;
+        if (name.ends_with(".jsa") && !name.starts_with(key + "-")) std::filesystem::remove(it->path(), remove_ec);
+    }
 }
 
-void compile_files(const std::vector<std::string>& files, const std::string& filetype)
+// AppCDS: the first run of a jar dumps the classes it loaded into an archive,
+// and later runs map that instead of loading and verifying them again. The
+// archive is named after the jar's contents and mtime (the JVM refuses one
+// whose jar's mtime moved) and the runtime it was dumped with, so a
+// recompile picks a new name and the stale archive is dropped when the new
+// one is dumped. MYJVM_CDS=0 turns it off.
+static ProgramLaunch java_launch(const std::vector<std::string>& args, const std::string& name)
 {
-    if (filetype == ".kt") compile_kotlin_files(files);
-    else if (filetype == ".scala") compile_scala_files(files);
-    else if (filetype == ".java") compile_java_files(files);
-    else cout << "Unknown extension. No files compiled." << endl;
+    ProgramLaunch launch;
+    launch.name = name;
+    std::filesystem::path jar = "out/all_files.jar";
+    std::error_code ec;
+    int64_t mtime = std::filesystem::last_write_time(jar, ec).time_since_epoch().count();
+    std::string key;
+    if (!ec) {
+        char buffer[40];
+        std::snprintf(buffer, sizeof(buffer), "%016llx-%llx", static_cast<unsigned long long>(hash_file(jar)),
+                      static_cast<unsigned long long>(mtime));
+        key = buffer;
+    }
+    std::optional<std::filesystem::path> image;
+    if (!key.empty()) image = program_image(jar, key);
+    std::filesystem::path java = image ? *image / "bin" / "java" : runtime_path("jvm-runtime-standard/bin/java");
+    launch.command = {java.string()};
+    std::vector<std::string> heap = heap_options();
+    launch.command.insert(launch.command.end(), heap.begin(), heap.end());
+    const char* cds = std::getenv("MYJVM_CDS");
+    if ((cds && std::string(cds) == "0") || key.empty()) {
+        launch.command.insert(launch.command.end(), args.begin(), args.end());
+        return launch;
+    }
+    std::string runtime = image ? image->filename().string() : "standard";
+    std::filesystem::path archive = CDS_DIR / (key + "-" + runtime + ".jsa");
+    if (std::filesystem::exists(archive)) launch.command.push_back("-XX:SharedArchiveFile=" + archive.string());
+    else {
+        launch.cds_archive = archive;
+        launch.cds_dump = archive;
+        launch.cds_dump += ".tmp-" + std::to_string(getpid());
+        remove_stale_archives(key);
+        std::filesystem::create_directories(CDS_DIR, ec);
+        launch.command.push_back("-XX:ArchiveClassesAtExit=" + launch.cds_dump.string());
+    }
+    // CDS reports classes it cannot archive on stdout; keep that out of the program's output.
+    launch.command.push_back("-Xlog:cds=off,cds+dynamic=off");
+    launch.command.insert(launch.command.end(), args.begin(), args.end());
+    return launch;
 }
 
-std::vector<uint8_t> load_file(const std::string& filepath) 
+void finish_program_launch(const ProgramLaunch& launch, int status)
 {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file) {
-        std::cerr << "Failed to open " << filepath << endl;
-        exit(1);
-    }
-    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if (launch.cds_dump.empty()) return;
+    // Only a run that exited normally leaves a complete archive.
+    std::error_code ec;
+    if (status == 0 && std::filesystem::exists(launch.cds_dump)) std::filesystem::rename(launch.cds_dump, launch.cds_archive, ec);
+    else std::filesystem::remove(launch.cds_dump, ec);
 }
 
-bool create_jar_from_classes(const std::vector<std::string>& class_files) 
+static int run_java(const std::vector<std::string>& args, const std::string& name)
 {
-    std::filesystem::path output_jar = "out/all_files.jar";
-    struct archive* a = archive_write_new();
-    archive_write_set_format_zip(a);
-    if (archive_write_open_filename(a, output_jar.c_str()) != ARCHIVE_OK) {
-        std::cerr << "Failed to open archive: " << archive_error_string(a) << std::endl;
-        archive_write_free(a);
-        return false;
-    }
-    for (const auto& filepath_str : class_files) {
-        std::filesystem::path filepath(filepath_str);
-        std::filesystem::path relative_path = std::filesystem::relative(filepath, "out");
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file) {
-            std::cerr << "Failed to read file: " << filepath << endl;
-            continue;
-        }
-        std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        struct archive_entry* entry = archive_entry_new();
-        archive_entry_set_pathname(entry, relative_path.string().c_str());
-        archive_entry_set_size(entry, buffer.size());
-        archive_entry_set_filetype(entry, AE_IFREG);
-        archive_entry_set_perm(entry, 0644);
-        archive_write_header(a, entry);
-        archive_write_data(a, buffer.data(), buffer.size());
-        archive_entry_free(entry);
+    ProgramLaunch launch = java_launch(args, name);
+    int status = run_program(launch.command, name);
+    finish_program_launch(launch, status);
+    return status;
+}
+
+// The jar carries the standard libraries its languages need, so it is the
+// whole classpath whatever the language.
+int run_known_class_file(const std::string& name, const std::string& filetype)
+{
+    if (filetype_languages(filetype).empty()) {
+        std::cerr << "Unknown file type provided." << endl;
+        return 1;
     }
-    archive_write_close(a);
-    archive_write_free(a);
-    cout << "Successfully created " << output_jar << "!" << endl;
-    return true;
+    cout << "Running: '" << name << "'" << endl;
+    return run_java({"-cp", "out/all_files.jar", name}, name);
 }
 
-bool add_scala_runtime(const std::string& jar_path)
+// The launch for `main_class`, or for the detected entry point when it is
+// empty; nullopt, after saying why, when there is nothing to run.
+std::optional<ProgramLaunch> plan_program_launch(const std::string& main_class, const std::string& filetype)
 {
-    struct archive* a = archive_read_new();
-    if (!a) {
-        std::cerr << "Failed to create archive object!" << endl;
-        return false;
+    if (filetype_languages(filetype).empty()) {
+        std::cerr << "Unknown file type provided." << endl;
+        return std::nullopt;
     }
-    archive_read_support_format_zip(a);
-    if (archive_read_open_filename(a, jar_path.c_str(), 10240) != ARCHIVE_OK) {
-        std::cerr << "Failed to open JAR: " << jar_path << " Error: " << archive_error_string(a) << std::endl;
-        archive_read_free(a);
-        return false;
+    if (!main_class.empty()) {
+        cout << "Running: '" << main_class << "'" << endl;
+        return java_launch({"-cp", "out/all_files.jar", main_class}, main_class);
     }
-    struct archive_entry* entry;
-    while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
-        const char* entry_name = archive_entry_pathname(entry);
-        if (!entry_name) {
-            std::cerr << "Encountered file with no name, skipping..." << endl;
-            archive_read_data_skip(a);
-            continue;
-        }
-        // Skip directories
-        if (archive_entry_filetype(entry) == AE_IFDIR) {
-            archive_read_data_skip(a);
-            continue;
-        }
-        std::filesystem::path output_path = std::filesystem::path("out") / entry_name;
-        std::filesystem::create_directories(output_path.parent_path());
-        std::ofstream out_file(output_path, std::ios::binary);
-        if (!out_file) {
-            std::cerr << "Failed to open output file for writing: " << output_path << std::endl;
-            archive_read_data_skip(a);
-            continue;
-        }
-        const void* buffer;
-        size_t size;
-        int64_t offset;
-        while (archive_read_data_block(a, &buffer, &size, &offset) == ARCHIVE_OK) {
-            out_file.write(reinterpret_cast<const char*>(buffer), size);
-        }
-        out_file.close();
+    std::vector<std::string> entry_points;
+    {
+        TraceScope trace("find_entry_points");
+        entry_points = find_entry_points(get_class_files());
     }
-    archive_read_close(a);
-    archive_read_free(a);
-    cout << "Successfully extracted " << jar_path << " into out/ directory." << endl;
-    return true;
+    if (entry_points.empty()) {
+        std::cerr << "No valid entrypoints detected." << endl;
+        return std::nullopt;
+    }
+    if (entry_points.size() > 1) {
+        cout << "Found " << entry_points.size() << " entrypoints, running the first. Pass a class name to pick another:" << endl;
+        for (const std::string& name : entry_points) cout << "  " << name << endl;
+    }
+    // The jar's manifest names the same class find_entry_points picks first,
+    // and the jar carries its languages' standard libraries, so no classpath
+    // is needed.
+    cout << "Running: '" << entry_points[0] << "'" << endl;
+    return java_launch({"-jar", "out/all_files.jar"}, entry_points[0]);
 }
 
-void write_embedded_archive_to_disk(const std::string& path)
+// Finds the entry point by reading the class files and launches only that
+// class.
+int run_detected_entry_point(const std::string& filetype)
 {
-    std::ofstream ofs(path, std::ios::binary);
-    if (!ofs) {
-        std::cerr << "Unable to open file: " << path << endl;
-        exit(1);
-    }
-    size_t archive_size = _binary__languages_tar_zst_end - _binary__languages_tar_zst_start;
-    ofs.write(reinterpret_cast<const char*>(_binary__languages_tar_zst_start), archive_size);
+    std::optional<ProgramLaunch> launch = plan_program_launch("", filetype);
+    if (!launch) return 1;
+    int status = run_program(launch->command, launch->name);
+    finish_program_launch(*launch, status);
+    return status;
 }
 
-void decompress_zstd_file(const std::string& input_path, const std::string& output_path)
+// Brings out/ and the jar up to date with `files`: everything is rebuilt when
+// there is no jar yet, RECOMPILE is set, the language changed or a source was
+// removed; otherwise only the changed sources and their API dependents.
+bool build_project(const std::vector<std::string>& files, const std::string& filetype)
 {
-    std::ifstream ifs(input_path, std::ios::binary);
-    if (!ifs) {
-        std::cerr << "Failed to open input file for decompression." << endl;
-        exit(1);
+    bool recompile = any_env_prefix_set("RECOMPILE");
+    BuildManifest manifest = BuildManifest::load(MANIFEST_PATH);
+    ManifestDiff diff = manifest.update(files);
+    bool full_build = !already_compiled(".") || recompile || manifest.filetype() != filetype;
+    if (!diff.removed.empty()) {
+        // Classes from deleted sources would otherwise linger in out/ and the jar.
+        std::filesystem::remove_all("out");
+        invalidate_class_files();
+        full_build = true;
     }
-    std::ofstream ofs(output_path, std::ios::binary);
-    if (!ofs) {
-        std::cerr << "Failed to open output file for decompression." << endl;
-        exit(1);
+    bool compiled = true;
+    if (full_build) {
+        compiled = compile_files(files, filetype);
+        if (compiled) AbiIndex::scan(get_class_files(), files).save(ABI_PATH);
     }
-    const size_t CHUNK_SIZE = 16384;
-    std::vector<char> in_buf(CHUNK_SIZE);
-    std::vector<char> out_buf(CHUNK_SIZE);
-    ZSTD_DStream* dstream = ZSTD_createDStream();
-    if (!dstream) {
-        std::cerr << "Failed to create ZSTD_DStream." << endl;
-        exit(1);
+    else if (!diff.changed.empty()) {
+        compiled = compile_changed_files(diff.changed, files, filetype);
     }
-    ZSTD_initDStream(dstream);
-    while (ifs) {
-        ifs.read(in_buf.data(), CHUNK_SIZE);
-        size_t bytes_read = ifs.gcount();
-        ZSTD_inBuffer input = { in_buf.data(), bytes_read, 0 };
-        while (input.pos < input.size) {
-            ZSTD_outBuffer output = { out_buf.data(), out_buf.size(), 0 };
-            size_t ret = ZSTD_decompressStream(dstream, &output, &input);
-            if (ZSTD_isError(ret)) {
-                throw std::runtime_error("Decompression error: " + std::string(ZSTD_getErrorName(ret)));
-            }
-            ofs.write(out_buf.data(), output.pos);
-        }
+    if (compiled && (full_build || !diff.empty())) {
+        manifest.set_filetype(filetype);
+        manifest.save(MANIFEST_PATH);
     }
-    ZSTD_freeDStream(dstream);
+    return compiled;
 }
 
-void extract_tar(const std::string& tar_path, const std::string& output_dir) 
+bool already_compiled(const std::filesystem::path& root)
 {
-    struct archive* a = archive_read_new();
-    archive_read_support_format_tar(a);
-    archive_read_support_filter_all(a); // In case it's compressed
-    if (archive_read_open_filename(a, tar_path.c_str(), 10240) != ARCHIVE_OK) {
-        throw std::runtime_error("Failed to open tar file: " + tar_path);
-    }
-    archive_entry* entry;
-    while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
-        std::filesystem::path full_path = std::filesystem::path(output_dir) / archive_entry_pathname(entry);
-        auto type = archive_entry_filetype(entry);
-        if (type == AE_IFDIR) {
-            std::filesystem::create_directories(full_path);
-        } 
-        else if (type == AE_IFREG) {
-            std::filesystem::create_directories(full_path.parent_path());
-            std::ofstream out(full_path, std::ios::binary);
-            if (!out) {
-                throw std::runtime_error("Failed to create output file: " + full_path.string());
-            }
-            const void* buff;
-            size_t size;
-            la_int64_t offset;
-            while (archive_read_data_block(a, &buff, &size, &offset) == ARCHIVE_OK) {
-                out.write(reinterpret_cast<const char*>(buff), size);
-            }
-        } 
+    std::filesystem::path output = root / "out" / "all_files.jar";
+    if (std::filesystem::exists(output)) return true;
+    return false;
+}
+
+bool compile_files(const std::vector<std::string>& files, const std::string& filetype)
+{
+    TraceScope trace("compile_files");
+    trace.arg("files", files.size());
+    invalidate_class_files();
+    if (filetype_languages(filetype).empty()) {
+        cout << "Unknown extension. No files compiled." << endl;
+        return false;
     }
+    size_t workers = compile_workers();
+    std::vector<CompileUnit> units = plan_compile_units(files, workers);
+    trace.arg("units", units.size());
+    cout << "Compiling " << files.size() << " file(s) in " << units.size() << " unit(s)..." << endl;
+    if (!compile_units(units, runtime_libraries(filetype), workers)) return false;
+    bool success = create_jar_from_classes(get_class_files(), runtime_library_layer(filetype));
+    if (success) cout << "Files compiled successfully!" << endl;
+    else cout << "Unable to archive files to a jar." << endl;
+    return success;
+}
 
-    archive_read_free(a);
+// Recompiles `changed`, then keeps widening the set to the sources that
+// reference a class whose API fingerprint moved, until it settles. Classes
+// that only changed internally leave their dependents untouched.
+bool compile_changed_files(const std::vector<std::string>& changed, 
+                           const std::vector<std::string>& files, 
+                           const std::string& filetype)
+{
+    AbiIndex before = AbiIndex::load(ABI_PATH);
+    std::set<std::string> compiled(changed.begin(), changed.end());
+    std::vector<std::string> batch = changed;
+    AbiIndex after;
+    while (!batch.empty()) {
+        // Drop the batch's previous output so classes it no longer defines
+        // disappear instead of lingering in out/.
+        for (const std::string& name : before.classes_from(batch)) {
+            std::filesystem::remove(std::filesystem::path("out") / (name + ".class"));
+            std::filesystem::remove(std::filesystem::path("out") / (name + ".tasty"));
+        }
+        if (!compile_files(batch, filetype)) return false;
+        after = AbiIndex::scan(get_class_files(), files);
+        bool constants_changed = false;
+        std::vector<std::string> api_changes = after.changed_since(before, constants_changed);
+        if (constants_changed) {
+            // Inlined constants leave no trace in their users' bytecode.
+            cout << "Compile-time constants changed, rebuilding everything..." << endl;
+            if (!compile_files(files, filetype)) return false;
+            return AbiIndex::scan(get_class_files(), files).save(ABI_PATH);
+        }
+        batch.clear();
+        for (const std::string& source : after.dependents_of(api_changes)) {
+            if (compiled.insert(source).second) batch.push_back(source);
+        }
+        if (!batch.empty()) cout << "API changed, recompiling " << batch.size() << " dependent file(s)..." << endl;
+    }
+    return after.save(ABI_PATH);
 }
 
-void restore_languages_directory()
+std::vector<uint8_t> load_file(const std::string& filepath) 
 {
-    write_embedded_archive_to_disk("temp_archive.zst");
-    decompress_zstd_file("temp_archive.zst", "temp_archive.tar");
-    extract_tar("temp_archive.tar", ".");
-    std::filesystem::remove("temp_archive.zst");
-    std::filesystem::remove("temp_archive.tar");
-    std::filesystem::permissions(".languages/jvm-runtime-standard/bin/java",
-                             std::filesystem::perms::owner_exec |
-                             std::filesystem::perms::group_exec |
-                             std::filesystem::perms::others_exec,
-                             std::filesystem::perm_options::add);
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << filepath << endl;
+        exit(1);
+    }
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
 
-    std::filesystem::permissions(".languages/jvm-runtime-standard/bin/javac",
-                             std::filesystem::perms::owner_exec |
-                             std::filesystem::perms::group_exec |
-                             std::filesystem::perms::others_exec,
-                             std::filesystem::perm_options::add);
-    std::filesystem::permissions(".languages/kotlin-compiler/kotlinc/bin/kotlinc", 
-                             std::filesystem::perms::owner_exec |
-                             std::filesystem::perms::group_exec |
-                             std::filesystem::perms::others_exec, 
-                             std::filesystem::perm_options::add);
+bool create_jar_from_classes(const std::vector<std::string>& class_files, const std::filesystem::path& layer) 
+{
+    TraceScope trace("create_jar");
+    std::filesystem::path output_jar = "out/all_files.jar";
+    std::vector<JarInput> inputs;
+    for (const std::string& file : class_files) {
+        inputs.push_back({std::filesystem::path(file).lexically_relative("out").generic_string(), file});
+    }
+    std::vector<std::string> entry_points = find_entry_points(class_files);
+    JarStats stats;
+    JarOptions options;
+    if (!entry_points.empty()) options.main_class = entry_points[0];
+    options.layer = layer;
+    if (!update_jar(output_jar, inputs, options, &stats)) return false;
+    trace.arg("written", stats.written);
+    trace.arg("reused", stats.reused);
+    cout << "Successfully created " << output_jar << " (" << stats.written << " entries written, " << stats.reused << " unchanged)!" << endl;
+    return true;
 }
 
 bool any_env_prefix_set(const std::string& target) 
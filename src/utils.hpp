@@ -1,28 +1,41 @@
 #pragma once
 
 #include <filesystem>
+#include <optional>
 #include "mystl.hpp"
 
-bool create_jar_from_classes(const std::vector<std::string>& class_files);
-std::string run_kotlin_jar();
-std::string run_known_scala_class_file(std::string& name);
-bool add_scala_runtime(const std::string& jar_path);
+// A program launch: the JVM command line, plus the AppCDS archive the run
+// dumps, which finish_program_launch keeps or discards by its exit status.
+struct ProgramLaunch
+{
+    std::vector<std::string> command;
+    std::string name;
+    std::filesystem::path cds_dump;  // empty if this run does not dump one
+    std::filesystem::path cds_archive;
+};
+
+bool create_jar_from_classes(const std::vector<std::string>& class_files, const std::filesystem::path& layer = {});
 std::vector<uint8_t> load_file(const std::string& filepath);
 std::vector<std::string> find_source_files(const std::filesystem::path& root);
-void compile_kotlin_files(const my::vector<std::string>& files);
-std::string try_run_scala_class_files(std::vector<std::string>& class_names);
-std::string run_known_java_class_file(std::string& name);
-std::string try_run_java_class_files(std::vector<std::string>& class_names);
-std::string try_run_class_files(std::vector<std::string>& class_names, const std::string& filetype);
-std::string run_known_class_file(std::string& name, const std::string& filetype);
+int run_detected_entry_point(const std::string& filetype);
+int run_known_class_file(const std::string& name, const std::string& filetype);
+std::optional<ProgramLaunch> plan_program_launch(const std::string& main_class, const std::string& filetype);
+void finish_program_launch(const ProgramLaunch& launch, int status);
+bool build_project(const std::vector<std::string>& files, const std::string& filetype);
 bool already_compiled(const std::filesystem::path& root);
 std::string infer_file_type(const std::filesystem::path& root);
-void compile_files(const std::vector<std::string>& files, const std::string& filetype);
+bool compile_files(const std::vector<std::string>& files, const std::string& filetype);
+bool compile_changed_files(const std::vector<std::string>& changed, const std::vector<std::string>& files, const std::string& filetype);
 std::vector<std::string> get_class_names();
 std::vector<std::string> get_class_files();
-void write_embedded_archive_to_disk(const std::string& path);
-void decompress_zstd_file(const std::string& input_path, const std::string& output_path);
-void extract_tar(const std::string& tar_path, const std::string& dest_dir);
-void restore_languages_directory();
 bool any_env_prefix_set(const std::string& target);
+std::string scala_compiler_classpath();
+std::string kotlin_compiler_classpath();
+std::vector<std::string> runtime_libraries(const std::string& filetype);
+std::filesystem::path runtime_library_layer(const std::string& filetype);
+std::vector<std::string> compiler_launcher(const std::string& language, const std::vector<std::string>& jvm_options = {});
+std::pair<int, std::string> run_compiler(const std::string& language, 
+                                         const std::vector<std::string>& launcher, 
+                                         const std::vector<std::string>& args,
+                                         bool use_daemon = true);
 
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include "os.hpp"
+#include "trace.hpp"
+#include "walker.hpp"
+
+#if OS_UNIX_LIKE_DEFINED
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+#endif
+#if defined(OS_LINUX)
+    #include <sys/syscall.h>
+#endif
+
+static const size_t DIRENT_BUFFER_SIZE = 32 << 10;
+// Queued directories per running walker thread before another one starts.
+static const size_t QUEUED_PER_THREAD = 8;
+
+// Matches one glob against text: '*' and '?' stop at '/', "**/" spans any
+// number of directories, a trailing "**" everything, and [...] is a class.
+bool glob_match(const char* pattern, const char* text)
+{
+    while (*pattern) {
+        if (pattern[0] == '*' && pattern[1] == '*') {
+            if (pattern[2] == '\0') return true;
+            if (pattern[2] == '/') {
+                for (const char* rest = text;; rest++) {
+                    if ((rest == text || rest[-1] == '/') && glob_match(pattern + 3, rest)) return true;
+                    if (*rest == '\0') return false;
+                }
+            }
+            pattern++;  // "**" elsewhere is a plain '*'
+        }
+        if (*pattern == '*') {
+            for (const char* rest = text;; rest++) {
+                if (glob_match(pattern + 1, rest)) return true;
+                if (*rest == '\0' || *rest == '/') return false;
+            }
+        }
+        if (*text == '\0') return false;
+        if (*pattern == '?') {
+            if (*text == '/') return false;
+        }
+        else if (*pattern == '[') {
+            const char* p = pattern + 1;
+            bool negate = *p == '!' || *p == '^';
+            if (negate) p++;
+            bool matched = false;
+            bool first = true;
+            while (*p && (first || *p != ']')) {
+                first = false;
+                if (p[1] == '-' && p[2] && p[2] != ']') {
+                    if (*p <= *text && *text <= p[2]) matched = true;
+                    p += 3;
+                }
+                else if (*p++ == *text) matched = true;
+            }
+            if (*p != ']') {
+                // No closing bracket: a literal '['.
+                if (*text != '[') return false;
+            }
+            else {
+                if (matched == negate || *text == '/') return false;
+                pattern = p;
+            }
+        }
+        else {
+            if (*pattern == '\\' && pattern[1]) pattern++;
+            if (*pattern != *text) return false;
+        }
+        pattern++;
+        text++;
+    }
+    return *text == '\0';
+}
+
+IgnoreRules::IgnoreRules(std::shared_ptr<const IgnoreRules> parent, std::string base)
+    : m_parent(std::move(parent)), m_base(std::move(base))
+{
+}
+
+void IgnoreRules::add(const std::string& line)
+{
+    std::string pattern = line;
+    if (!pattern.empty() && pattern.back() == '\r') pattern.pop_back();
+    // Trailing spaces are ignored unless escaped.
+    while (!pattern.empty() && pattern.back() == ' ' && (pattern.size() < 2 || pattern[pattern.size() - 2] != '\\')) pattern.pop_back();
+    if (pattern.empty() || pattern[0] == '#') return;
+    Rule rule = {"", false, false, false};
+    if (pattern[0] == '!') {
+        rule.negated = true;
+        pattern.erase(0, 1);
+    }
+    else if (pattern[0] == '\\') pattern.erase(0, 1);
+    if (!pattern.empty() && pattern.back() == '/') {
+        rule.directory_only = true;
+        pattern.pop_back();
+    }
+    rule.anchored = pattern.find('/') != std::string::npos;
+    if (!pattern.empty() && pattern[0] == '/') pattern.erase(0, 1);
+    if (pattern.empty()) return;
+    rule.pattern = pattern;
+    m_rules.push_back(std::move(rule));
+}
+
+bool IgnoreRules::load(const std::filesystem::path& file)
+{
+    std::ifstream in(file);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) add(line);
+    return true;
+}
+
+std::optional<bool> IgnoreRules::verdict(const std::string& path, bool is_directory) const
+{
+    std::optional<bool> result = m_parent ? m_parent->verdict(path, is_directory) : std::nullopt;
+    if (m_rules.empty() || path.compare(0, m_base.size(), m_base) != 0) return result;
+    const char* relative = path.c_str() + m_base.size();
+    size_t slash = path.rfind('/');
+    const char* name = slash == std::string::npos ? path.c_str() : path.c_str() + slash + 1;
+    for (const Rule& rule : m_rules) {
+        if (rule.directory_only && !is_directory) continue;
+        if (glob_match(rule.pattern.c_str(), rule.anchored ? relative : name)) result = !rule.negated;
+    }
+    return result;
+}
+
+bool IgnoreRules::ignored(const std::string& path, bool is_directory) const
+{
+    return verdict(path, is_directory).value_or(false);
+}
+
+// A directory still to be read, relative to the root ("" or ending in '/').
+struct WalkTask
+{
+    std::string path;
+    std::shared_ptr<const IgnoreRules> rules;
+};
+
+enum class EntryType { File, Directory, Other };
+
+struct RawEntry
+{
+    std::string name;
+    EntryType type;
+};
+
+#if OS_UNIX_LIKE_DEFINED
+static EntryType stat_type(int dir_fd, const char* name, bool follow)
+{
+    struct stat st;
+    if (fstatat(dir_fd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) == -1) return EntryType::Other;
+    if (S_ISREG(st.st_mode)) return EntryType::File;
+    if (S_ISDIR(st.st_mode)) return EntryType::Directory;
+    if (S_ISLNK(st.st_mode)) {
+        // Like recursive_directory_iterator: a link to a file counts as the
+        // file, a link to a directory is not followed.
+        return stat_type(dir_fd, name, true) == EntryType::File ? EntryType::File : EntryType::Other;
+    }
+    return EntryType::Other;
+}
+
+static EntryType classify(int dir_fd, const char* name, unsigned char d_type)
+{
+    if (d_type == DT_REG) return EntryType::File;
+    if (d_type == DT_DIR) return EntryType::Directory;
+    if (d_type == DT_LNK) return stat_type(dir_fd, name, true) == EntryType::File ? EntryType::File : EntryType::Other;
+    if (d_type == DT_UNKNOWN) return stat_type(dir_fd, name, false);
+    return EntryType::Other;
+}
+
+#if defined(OS_LINUX)
+struct LinuxDirent64
+{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+static bool read_entries(int root_fd, const std::string& path, std::vector<char>& buffer, std::vector<RawEntry>& entries)
+{
+    int fd = openat(root_fd, path.empty() ? "." : path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) return false;
+    #if defined(OS_LINUX)
+    while (true) {
+        long n = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+        if (n <= 0) break;
+        for (long pos = 0; pos < n;) {
+            const LinuxDirent64* dirent = reinterpret_cast<const LinuxDirent64*>(buffer.data() + pos);
+            pos += dirent->d_reclen;
+            const char* name = dirent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+            entries.push_back({name, classify(fd, name, dirent->d_type)});
+        }
+    }
+    close(fd);
+    #else
+    DIR* dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return false;
+    }
+    while (struct dirent* dirent = readdir(dir)) {
+        const char* name = dirent->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        entries.push_back({name, classify(fd, name, dirent->d_type)});
+    }
+    closedir(dir);
+    #endif
+    return true;
+}
+#else
+static bool read_entries(const std::filesystem::path& root, const std::string& path, std::vector<RawEntry>& entries)
+{
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(root / path, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        EntryType type = it->is_symlink() ? (it->is_regular_file() ? EntryType::File : EntryType::Other)
+                       : it->is_directory() ? EntryType::Directory
+                       : it->is_regular_file() ? EntryType::File : EntryType::Other;
+        entries.push_back({it->path().filename().string(), type});
+    }
+    return !ec;
+}
+#endif
+
+// One walker thread's queue and findings.
+struct WalkWorker
+{
+    std::mutex mutex;
+    std::deque<WalkTask> tasks;
+    std::vector<std::string> files;
+    std::vector<std::string> directories;
+};
+
+class DirectoryWalker
+{
+private:
+    // Fields
+    std::filesystem::path m_root;
+    std::string m_prefix;  // root as results spell it, ending in a separator
+    WalkOptions m_options;
+    std::vector<std::unique_ptr<WalkWorker>> m_workers;  // one per thread that may run; m_started of them do
+    std::atomic<size_t> m_pending{0};  // directories queued or being read
+    std::atomic<size_t> m_queued{0};  // directories waiting in a queue
+    std::atomic<size_t> m_idle{0};  // threads asleep on m_wake
+    std::atomic<size_t> m_started{1};  // the calling thread is worker 0
+    std::mutex m_mutex;  // guards m_threads and sleeping on m_wake
+    std::condition_variable m_wake;
+    std::vector<std::thread> m_threads;
+    #if OS_UNIX_LIKE_DEFINED
+    int m_root_fd = -1;
+    #endif
+
+    // Wakes a sleeping thread for the new task, or starts another one once
+    // the queues hold more than the running ones keep up with.
+    void push(size_t worker, WalkTask task)
+    {
+        m_pending++;
+        {
+            std::lock_guard<std::mutex> lock(m_workers[worker]->mutex);
+            m_workers[worker]->tasks.push_back(std::move(task));
+        }
+        size_t queued = ++m_queued;
+        if (m_idle > 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_wake.notify_one();
+        }
+        else if (queued > m_started * QUEUED_PER_THREAD && m_started < m_workers.size()) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            size_t index = m_started;
+            if (index == m_workers.size()) return;
+            m_started++;
+            m_threads.emplace_back([this, index] { work(index); });
+        }
+    }
+
+    // Newest task from our own queue, else the oldest from someone else's:
+    // that is the shallowest directory, so it is likely to bring the most
+    // work with it.
+    std::optional<WalkTask> next(size_t worker)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_workers[worker]->mutex);
+            std::deque<WalkTask>& tasks = m_workers[worker]->tasks;
+            if (!tasks.empty()) {
+                WalkTask task = std::move(tasks.back());
+                tasks.pop_back();
+                m_queued--;
+                return task;
+            }
+        }
+        size_t started = m_started;
+        for (size_t i = 1; i < started; i++) {
+            WalkWorker& victim = *m_workers[(worker + i) % started];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            WalkTask task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_queued--;
+            return task;
+        }
+        return std::nullopt;
+    }
+
+    void visit(size_t worker, const WalkTask& task, std::vector<char>& buffer)
+    {
+        std::vector<RawEntry> entries;
+        #if OS_UNIX_LIKE_DEFINED
+        if (!read_entries(m_root_fd, task.path, buffer, entries)) return;
+        #else
+        if (!read_entries(m_root, task.path, entries)) return;
+        #endif
+        std::shared_ptr<const IgnoreRules> rules = task.rules;
+        if (m_options.gitignore) {
+            bool has_gitignore = std::any_of(entries.begin(), entries.end(), [](const RawEntry& entry) {
+                return entry.type == EntryType::File && entry.name == ".gitignore";
+            });
+            if (has_gitignore) {
+                auto local = std::make_shared<IgnoreRules>(rules, task.path);
+                local->load(m_root / task.path / ".gitignore");
+                if (!local->empty()) rules = local;
+            }
+        }
+        std::vector<std::string>& files = m_workers[worker]->files;
+        for (const RawEntry& entry : entries) {
+            if (entry.type == EntryType::Other) continue;
+            std::string path = task.path + entry.name;
+            bool is_directory = entry.type == EntryType::Directory;
+            if (rules && rules->ignored(path, is_directory)) continue;
+            if (is_directory) {
+                m_workers[worker]->directories.push_back(m_prefix + path);
+                push(worker, {path + "/", rules});
+            }
+            else files.push_back(m_prefix + path);
+        }
+    }
+
+    // Idle threads sleep until a task is queued or the walk is over.
+    void work(size_t worker)
+    {
+        std::vector<char> buffer(DIRENT_BUFFER_SIZE);
+        while (true) {
+            std::optional<WalkTask> task = next(worker);
+            if (!task) {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_idle++;
+                m_wake.wait(lock, [this] { return m_queued > 0 || m_pending == 0; });
+                m_idle--;
+                if (m_pending == 0) return;
+                continue;
+            }
+            visit(worker, *task, buffer);
+            if (--m_pending == 0) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_wake.notify_all();
+            }
+        }
+    }
+public:
+    DirectoryWalker(const std::filesystem::path& root, const WalkOptions& options)
+        : m_root(root), m_prefix((root / "").string()), m_options(options)
+    {
+    }
+
+    WalkResult run()
+    {
+        #if OS_UNIX_LIKE_DEFINED
+        m_root_fd = open(m_root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (m_root_fd == -1) return {};
+        #endif
+        std::shared_ptr<IgnoreRules> root_rules;
+        if (!m_options.ignore.empty()) {
+            root_rules = std::make_shared<IgnoreRules>(nullptr, "");
+            for (const std::string& pattern : m_options.ignore) root_rules->add(pattern);
+        }
+        size_t threads = m_options.threads ? m_options.threads : std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < threads; i++) m_workers.push_back(std::make_unique<WalkWorker>());
+        push(0, {"", root_rules});
+        work(0);
+        // No task is left, so no thread can be started any more.
+        for (std::thread& thread : m_threads) thread.join();
+        #if OS_UNIX_LIKE_DEFINED
+        close(m_root_fd);
+        #endif
+        WalkResult result;
+        result.directories.push_back(m_root.string());
+        for (const auto& worker : m_workers) {
+            result.files.insert(result.files.end(), worker->files.begin(), worker->files.end());
+            result.directories.insert(result.directories.end(), worker->directories.begin(), worker->directories.end());
+        }
+        std::sort(result.files.begin(), result.files.end());
+        std::sort(result.directories.begin(), result.directories.end());
+        return result;
+    }
+};
+
+WalkResult walk_tree(const std::filesystem::path& root, const WalkOptions& options)
+{
+    TraceScope trace("walk_files");
+    trace.arg("root", root.string());
+    WalkResult result = DirectoryWalker(root, options).run();
+    trace.arg("files", result.files.size());
+    trace.arg("directories", result.directories.size());
+    return result;
+}
+
+std::vector<std::string> walk_files(const std::filesystem::path& root, const WalkOptions& options)
+{
+    return walk_tree(root, options).files;
+}
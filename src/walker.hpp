@@ -0,0 +1,63 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Parallel directory walk for large source trees. Directories are read with
+// getdents64 on Linux (readdir elsewhere) and the entry type it reports is
+// trusted, so only symlinks and filesystems that report no type cost a
+// stat. Each worker goes depth-first through its own queue of directories
+// and steals the oldest one from another worker when it runs dry, sleeping
+// when there is nothing to steal. The walk starts on the calling thread and
+// adds threads only while directories queue up faster than they are read.
+// Results are sorted, so their order does not depend on scheduling.
+
+// Patterns in .gitignore syntax, relative to the directory they came from.
+// Rules from parent directories apply first; the last match decides.
+class IgnoreRules
+{
+private:
+    struct Rule
+    {
+        std::string pattern;
+        bool negated;
+        bool directory_only;
+        bool anchored;  // contains a '/', so it matches the whole relative path
+    };
+
+    // Fields
+    std::shared_ptr<const IgnoreRules> m_parent;
+    std::string m_base;  // directory the rules came from, relative to the walk root, "" or ending in '/'
+    std::vector<Rule> m_rules;
+
+    std::optional<bool> verdict(const std::string& path, bool is_directory) const;
+public:
+    IgnoreRules(std::shared_ptr<const IgnoreRules> parent, std::string base);
+    void add(const std::string& line);
+    bool load(const std::filesystem::path& file);
+    inline bool empty() const { return m_rules.empty(); }
+    bool ignored(const std::string& path, bool is_directory) const;  // `path` relative to the walk root
+};
+
+bool glob_match(const char* pattern, const char* text);
+
+struct WalkOptions
+{
+    std::vector<std::string> ignore;  // extra patterns, as if from a .gitignore at the root
+    bool gitignore = true;  // also honour .gitignore files found along the way
+    size_t threads = 0;  // most threads to use, 0 for one per core; more start only as the queues grow
+};
+
+struct WalkResult
+{
+    std::vector<std::string> files;
+    std::vector<std::string> directories;  // the root and every directory walked into
+};
+
+// Regular files under `root` (following symlinks to files, not to
+// directories), spelled as root / relative path, sorted.
+WalkResult walk_tree(const std::filesystem::path& root, const WalkOptions& options = {});
+std::vector<std::string> walk_files(const std::filesystem::path& root, const WalkOptions& options = {});
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include "daemon.hpp"
+#include "os.hpp"
+#include "prewarm.hpp"
+#include "project.hpp"
+#include "runtime.hpp"
+#include "trace.hpp"
+#include "utils.hpp"
+#include "watch.hpp"
+
+#if defined(OS_LINUX)
+    #include <poll.h>
+    #include <sys/inotify.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+#if defined(OS_LINUX)
+// Quiet time after the last event before a burst counts as finished; editors
+// and formatters tend to write several times per save.
+static const int DEBOUNCE_MS = 150;
+static const uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_DELETE_SELF;
+
+// One inotify watch per source directory, so events can be traced back to
+// the directory they happened in.
+class DirectoryWatches
+{
+private:
+    // Fields
+    int m_fd;
+    std::map<int, std::filesystem::path> m_paths;
+    std::set<std::string> m_watched;
+public:
+    // Constructor
+    DirectoryWatches(int fd) : m_fd(fd) {}
+
+    // Methods
+    // Existing watches are kept.
+    void add(const std::vector<std::string>& directories)
+    {
+        for (const std::string& directory : directories) {
+            if (m_watched.count(directory)) continue;
+            int wd = inotify_add_watch(m_fd, directory.c_str(), WATCH_EVENTS);
+            if (wd == -1) {
+                perror(("Unable to watch " + directory).c_str());
+                continue;
+            }
+            m_paths[wd] = directory;
+            m_watched.insert(directory);
+        }
+    }
+
+    // The directory is gone or no longer watched.
+    void remove(int wd)
+    {
+        auto it = m_paths.find(wd);
+        if (it == m_paths.end()) return;
+        m_watched.erase(it->second.string());
+        m_paths.erase(it);
+    }
+
+    std::filesystem::path path(int wd) const
+    {
+        auto it = m_paths.find(wd);
+        return it == m_paths.end() ? std::filesystem::path() : it->second;
+    }
+};
+
+// out/ and .languages/ belong to the tool; the build itself writes there.
+static bool tool_directory(const std::filesystem::path& root, const std::filesystem::path& path)
+{
+    std::filesystem::path absolute = std::filesystem::absolute(path).lexically_normal();
+    for (const std::filesystem::path& owned : {std::filesystem::absolute("out").lexically_normal(),
+                                               (std::filesystem::absolute(root) / ".languages").lexically_normal()}) {
+        std::filesystem::path relative = absolute.lexically_relative(owned);
+        if (!relative.empty() && *relative.begin() != "..") return true;
+    }
+    return false;
+}
+
+// Drains the pending events; true if any of them could change the build.
+// New directories are rescanned right away, so sources created in them
+// before the next rebuild are seen too.
+static bool read_events(int fd, const std::filesystem::path& root, DirectoryWatches& watches)
+{
+    alignas(inotify_event) char buffer[16 << 10];
+    bool relevant = false;
+    bool new_directories = false;
+    while (true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+        for (char* p = buffer; p < buffer + n;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                new_directories = true;
+                relevant = true;
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watches.remove(event->wd);
+                relevant = true;
+                continue;
+            }
+            if (event->mask & IN_DELETE_SELF) {
+                relevant = true;
+                continue;
+            }
+            std::string name = event->len ? event->name : "";
+            if (event->mask & IN_ISDIR) {
+                if (tool_directory(root, watches.path(event->wd) / name)) continue;
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) new_directories = true;
+                relevant = true;
+            }
+            else if (!source_type(name).empty()) relevant = true;
+        }
+    }
+    if (new_directories) {
+        invalidate_project_index();
+        watches.add(project_index(root).directories);
+    }
+    return relevant;
+}
+
+// Waits until a relevant change arrives and the events stop for DEBOUNCE_MS,
+// reporting the running program's exit while it waits. False once asked to
+// stop.
+static bool wait_for_changes(int fd, const std::filesystem::path& root, DirectoryWatches& watches,
+                             Process& program, const ProgramLaunch* launch)
+{
+    bool changed = false;
+    while (true) {
+        if (OS::stop_requested()) return false;
+        pollfd pfd = {fd, POLLIN, 0};
+        int timeout = changed ? DEBOUNCE_MS : (program.valid() ? 100 : -1);
+        int ready = poll(&pfd, 1, timeout);
+        if (ready == -1 && errno != EINTR) {
+            perror("poll failed");
+            return true;
+        }
+        if (ready > 0) {
+            if (read_events(fd, root, watches)) changed = true;
+            continue;
+        }
+        if (changed) return true;
+        if (program.valid()) {
+            std::optional<int> status = program.poll();
+            if (!status) continue;
+            finish_program_launch(*launch, *status);
+            cout << "'" << launch->name << "' exited with status " << *status << ". Waiting for changes..." << endl;
+            program = Process();
+        }
+    }
+}
+
+// Installs the runtimes and starts the compile daemons `filetype` needs.
+static void prepare_languages(const std::string& filetype)
+{
+    std::vector<std::string> components = runtime_components(filetype);
+    ensure_runtime(components);
+    prewarm_components(components);
+    // Keep the compilers warm between iterations.
+    for (const std::string& language : filetype_languages(filetype)) {
+        std::string daemon = language == ".java" ? "java" : (language == ".scala" ? "scala" : "kotlin");
+        if (!daemon_running(daemon)) start_daemon(daemon);
+    }
+}
+
+int run_watch_command(const std::filesystem::path& root, const std::string& main_class)
+{
+    std::string filetype = infer_file_type(root);
+    if (filetype == "UNKNOWN") {
+        std::cerr << "No Java, Scala or Kotlin sources under " << root.string() << endl;
+        return 1;
+    }
+    prepare_languages(filetype);
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1) {
+        perror("inotify_init1 failed");
+        return 1;
+    }
+    DirectoryWatches watches(fd);
+    Process program;
+    std::optional<ProgramLaunch> launch;
+    // Ctrl-C ends the loop below, so the run is stopped and the trace written.
+    OS::catch_stop_signals();
+    while (!OS::stop_requested()) {
+        TraceScope trace("watch_iteration");
+        if (program.valid()) {
+            // The jar is about to be rewritten under it.
+            cout << "Sources changed, stopping '" << launch->name << "'..." << endl;
+            program.kill();
+            finish_program_launch(*launch, program.wait());
+            program = Process();
+        }
+        invalidate_project_index();
+        std::vector<std::string> files = find_source_files(root);
+        watches.add(project_index(root).directories);
+        // A file in another language may have been added since the last build.
+        std::string current = infer_file_type(root);
+        if (current != filetype && current != "UNKNOWN") prepare_languages(current);
+        filetype = current;
+        if (filetype == "UNKNOWN") cout << "No Java, Scala or Kotlin sources left." << endl;
+        else if (build_project(files, filetype)) {
+            launch = plan_program_launch(main_class, filetype);
+            if (launch) {
+                program = OS::spawn(launch->command);
+                if (!program.valid()) std::cerr << "Unable to start '" << launch->name << "'." << endl;
+            }
+        }
+        if (!program.valid()) cout << "Waiting for changes..." << endl;
+        if (!wait_for_changes(fd, root, watches, program, launch ? &*launch : nullptr)) break;
+    }
+    if (program.valid()) {
+        program.kill();
+        finish_program_launch(*launch, program.wait());
+    }
+    close(fd);
+    return 0;
+}
+#else
+int run_watch_command(const std::filesystem::path& root, const std::string& main_class)
+{
+    std::cerr << "Watch mode needs inotify and is only available on Linux." << endl;
+    return 1;
+}
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+// `myjvm watch`: builds and runs the project, then waits on inotify for its
+// sources to change. Each burst of changes stops a run still in progress,
+// recompiles only what changed (through the warm daemon where there is one)
+// and starts the program again. Linux only.
+
+int run_watch_command(const std::filesystem::path& root, const std::string& main_class);
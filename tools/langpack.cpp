@@ -0,0 +1,43 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/langpack.hpp"
+
+using std::endl;
+
+// Build-time packer for the embedded runtime archive. Each component is a
+// tar of one top-level directory of .languages.
+// Usage: langpack [--frame-size MB] [--level N] <output.tar.zst> <component>=<component.tar>...
+int main(int argc, char** argv)
+{
+    size_t frame_size = 4 << 20;
+    int level = 19;
+    std::string output;
+    std::vector<PackInput> inputs;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frame-size" && i + 1 < argc) frame_size = std::strtoul(argv[++i], nullptr, 10) << 20;
+        else if (arg == "--level" && i + 1 < argc) level = std::atoi(argv[++i]);
+        else if (output.empty()) output = arg;
+        else {
+            size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                std::cerr << "Expected <component>=<component.tar>, got: " << arg << endl;
+                return 1;
+            }
+            inputs.push_back({arg.substr(0, eq), arg.substr(eq + 1)});
+        }
+    }
+    if (output.empty() || inputs.empty()) {
+        std::cerr << "Usage: langpack [--frame-size MB] [--level N] <output.tar.zst> <component>=<component.tar>..." << endl;
+        return 1;
+    }
+    if (frame_size == 0) {
+        std::cerr << "Frame size must be at least 1 MB." << endl;
+        return 1;
+    }
+    if (!write_seekable_archive(inputs, output, frame_size, level)) return 1;
+    std::cout << "Wrote " << output << endl;
+    return 0;
+}